@@ -0,0 +1,666 @@
+#include "Benchmark.hpp"
+#include "Fixtures.hpp"
+#include "StandInServer.hpp"
+#include "GeodeInstaller.hpp"
+#include "SteamGameFinder.hpp"
+#include "VdfDocument.hpp"
+#include "ZipStreamExtractor.hpp"
+#include "ReleaseStore.hpp"
+#include "PrefixScanner.hpp"
+#include "Progress.hpp"
+#include <algorithm>
+#include <map>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+
+std::atomic<uint64_t> g_allocation_count{0};
+std::atomic<uint64_t> g_allocated_bytes{0};
+
+// counting every allocation in the process. every replaced new goes
+// through malloc and every delete through free, so each pair matches
+static void* counted_alloc(size_t size, size_t alignment) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* ptr = nullptr;
+    if (alignment <= alignof(std::max_align_t)) {
+        ptr = std::malloc(size ? size : 1);
+    } else if (posix_memalign(&ptr, alignment, size ? size : 1) != 0) {
+        ptr = nullptr;
+    }
+
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new(size_t size) {
+    return counted_alloc(size, 0);
+}
+
+void* operator new[](size_t size) {
+    return counted_alloc(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return counted_alloc(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+BenchRunner::BenchRunner(size_t iterations, std::string filter)
+    : iterations_(std::max<size_t>(iterations, 1)), filter_(std::move(filter)) {}
+
+void BenchRunner::run(const std::string& name, uint64_t bytes_per_iteration,
+                      const std::function<void()>& setup, const std::function<void()>& body) {
+    if (!filter_.empty() && name.find(filter_) == std::string::npos) {
+        return;
+    }
+
+    BenchResult result;
+    result.name = name;
+    result.iterations = iterations_;
+    result.bytes_per_iteration = bytes_per_iteration;
+
+    double total_ms = 0;
+    uint64_t allocations = 0;
+    uint64_t allocated_bytes = 0;
+
+    for (size_t i = 0; i < iterations_; i++) {
+        setup();
+
+        uint64_t count_before = g_allocation_count.load();
+        uint64_t bytes_before = g_allocated_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+
+        body();
+
+        auto end = std::chrono::steady_clock::now();
+        allocations += g_allocation_count.load() - count_before;
+        allocated_bytes += g_allocated_bytes.load() - bytes_before;
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        total_ms += ms;
+        result.min_ms = i == 0 ? ms : std::min(result.min_ms, ms);
+        result.max_ms = std::max(result.max_ms, ms);
+    }
+
+    result.mean_ms = total_ms / iterations_;
+    result.allocations_per_iteration = static_cast<double>(allocations) / iterations_;
+    result.allocated_bytes_per_iteration = static_cast<double>(allocated_bytes) / iterations_;
+    if (bytes_per_iteration > 0 && result.mean_ms > 0) {
+        result.throughput_mb_s = (bytes_per_iteration / (1024.0 * 1024.0)) / (result.mean_ms / 1000.0);
+    }
+
+    std::cerr << name << ": " << result.mean_ms << " ms mean, " << result.min_ms << " ms min, "
+              << result.allocations_per_iteration << " allocations" << std::endl;
+
+    results_.push_back(result);
+}
+
+Json::Value BenchRunner::to_json() const {
+    Json::Value root;
+    root["iterations"] = static_cast<Json::UInt64>(iterations_);
+    root["results"] = Json::Value(Json::arrayValue);
+
+    for (const auto& result : results_) {
+        Json::Value entry;
+        entry["name"] = result.name;
+        entry["mean_ms"] = result.mean_ms;
+        entry["min_ms"] = result.min_ms;
+        entry["max_ms"] = result.max_ms;
+        entry["bytes_per_iteration"] = static_cast<Json::UInt64>(result.bytes_per_iteration);
+        entry["throughput_mb_s"] = result.throughput_mb_s;
+        entry["allocations_per_iteration"] = result.allocations_per_iteration;
+        entry["allocated_bytes_per_iteration"] = result.allocated_bytes_per_iteration;
+        root["results"].append(entry);
+    }
+    return root;
+}
+
+static std::string read_file(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+static uint64_t file_size_or_zero(const fs::path& path) {
+    std::error_code ec;
+    uint64_t size = fs::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+// what an install bench case runs against, see prepare_install in main
+struct InstallFixture {
+    InstallerOptions options;
+    fs::path prefix;
+    fs::path gd_dir;
+};
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 10;
+    std::string filter;
+    fs::path output_path;
+    fs::path workdir = fs::temp_directory_path() / "geode-installer-bench";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::stoul(argv[++i]);
+        } else if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            output_path = argv[++i];
+        } else if (arg == "--workdir" && i + 1 < argc) {
+            workdir = argv[++i];
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            std::cerr << "Usage: installer_bench [--iterations N] [--filter NAME] [--output FILE] [--workdir DIR]"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    // the installer reports progress on stdout, which would end up in the JSON
+    std::streambuf* stdout_buffer = std::cout.rdbuf(nullptr);
+
+    try {
+        fs::remove_all(workdir);
+        fs::create_directories(workdir);
+
+        // SteamGameFinder and the caches only look at these
+        fs::path home = workdir / "home";
+        fs::path cache_dir = workdir / "cache";
+        setenv("HOME", home.c_str(), 1);
+        setenv("XDG_CACHE_HOME", cache_dir.c_str(), 1);
+
+        std::cerr << "Generating fixtures in " << workdir << std::endl;
+
+        generate_steam_tree(home, 4, 250);
+        fs::path library_vdf = home / ".steam" / "steam" / "steamapps" / "libraryfolders.vdf";
+        fs::path appmanifest = home / "library3" / "steamapps" / "appmanifest_322170.acf";
+        fs::path index_file = cache_dir / "geode-installer" / "steam-index.json";
+
+        fs::path reg_fixture = workdir / "user.reg.fixture";
+        fs::path reg_file = workdir / "user.reg";
+        uint64_t reg_size = generate_user_reg(reg_fixture, 8);
+
+        fs::path zip_file = workdir / "geode-win.zip";
+        uint64_t zip_uncompressed = generate_geode_zip(zip_file);
+        uint64_t zip_compressed = file_size_or_zero(zip_file);
+        fs::path extract_dir = workdir / "extract";
+
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+
+        BenchRunner runner(iterations, filter);
+
+        runner.run("vdf_parse_libraryfolders", file_size_or_zero(library_vdf), [&] {
+            auto document = VdfDocument::load(library_vdf);
+            if (!document || document->node_count() < 2) {
+                throw std::runtime_error("Failed to parse benchmark libraryfolders.vdf");
+            }
+        });
+
+        runner.run("vdf_parse_appmanifest_early_stop", file_size_or_zero(appmanifest), [&] {
+            auto document = VdfDocument::load(appmanifest, {"AppState.installdir"});
+            if (!document || !document->find("AppState.installdir")) {
+                throw std::runtime_error("Failed to parse benchmark appmanifest");
+            }
+        });
+
+        // initialize_library_folders + a full lookup without the on-disk index
+        runner.run("steam_discovery_cold", 0, [&] { fs::remove(index_file); }, [&] {
+            SteamGameFinder finder;
+            if (!finder.get_game_info("322170").found) {
+                throw std::runtime_error("Benchmark Steam tree has no Geometry Dash");
+            }
+        });
+
+        {
+            SteamGameFinder warmup;
+            warmup.get_game_info("322170");
+        }
+
+        runner.run("steam_discovery_indexed", 0, [&] {
+            SteamGameFinder finder;
+            if (!finder.get_game_info("322170").found) {
+                throw std::runtime_error("Benchmark Steam tree has no Geometry Dash");
+            }
+        });
+
+        runner.run("steam_bulk_all_apps", 0, [&] {
+            SteamGameFinder finder;
+            finder.get_games_info();
+        });
+
+        // the Wine, Lutris, Bottles and Heroic prefix search
+        size_t wine_games = generate_wine_prefixes(home, 400);
+        fs::path prefix_cache = cache_dir / "geode-installer" / "wine-targets.json";
+        auto check_discovery = [&](const DiscoveryResult& result) {
+            if (result.installs.size() != wine_games) {
+                throw std::runtime_error("Prefix search found " + std::to_string(result.installs.size()) + " of " +
+                                         std::to_string(wine_games) + " Geometry Dash installs");
+            }
+        };
+
+        runner.run("prefix_scan", 0, [&] {
+            check_discovery(PrefixScanner(PrefixScanner::default_roots(home), prefix_cache).scan());
+        });
+
+        runner.run("prefix_scan_single_thread", 0, [&] {
+            check_discovery(PrefixScanner(PrefixScanner::default_roots(home), prefix_cache, 1).scan());
+        });
+
+        PrefixScanner(PrefixScanner::default_roots(home), prefix_cache).discover(true);
+
+        runner.run("prefix_discover_cached", 0, [&] {
+            DiscoveryResult result = PrefixScanner(PrefixScanner::default_roots(home), prefix_cache).discover();
+            if (!result.from_cache) {
+                throw std::runtime_error("Prefix search cache was not used");
+            }
+            check_discovery(result);
+        });
+
+        GeodeInstaller installer;
+
+        runner.run("patch_prefix_registry", reg_size,
+                   [&] { fs::copy_file(reg_fixture, reg_file, fs::copy_options::overwrite_existing); },
+                   [&] { installer.patch_prefix_registry(reg_file); });
+
+        runner.run("extract_zip", zip_uncompressed, [&] { fs::remove_all(extract_dir); },
+                   [&] { installer.extract_zip(zip_file, extract_dir, threads); });
+
+        runner.run("extract_zip_single_thread", zip_uncompressed, [&] { fs::remove_all(extract_dir); },
+                   [&] { installer.extract_zip(zip_file, extract_dir, 1); });
+
+        // re-running over an up-to-date tree only compares CRCs
+        InstallerOptions incremental_options;
+        incremental_options.incremental = true;
+        GeodeInstaller incremental_installer(incremental_options);
+        installer.extract_zip(zip_file, extract_dir, threads);
+
+        runner.run("extract_zip_incremental_noop", zip_uncompressed,
+                   [&] { incremental_installer.extract_zip(zip_file, extract_dir, threads); });
+
+        runner.run("zip_stream_extract", zip_compressed, [&] { fs::remove_all(extract_dir); }, [&] {
+            std::ifstream input(zip_file, std::ios::binary);
+            ZipStreamExtractor extractor(extract_dir);
+
+            // network-sized chunks, like the download path feeds it
+            std::vector<char> chunk(16 * 1024);
+            while (input.read(chunk.data(), chunk.size()) || input.gcount() > 0) {
+                extractor.feed(chunk.data(), static_cast<size_t>(input.gcount()));
+            }
+            extractor.finish();
+        });
+
+        // installing a release that is already in the content-addressed store,
+        // without and with hardlinks allowed. reflinks are used instead when
+        // the workdir's filesystem has them
+        for (bool hardlinks : {false, true}) {
+            ReleaseStore store(workdir / (hardlinks ? "store-hardlinks" : "store"), hardlinks);
+            fs::path staging_dir = store.create_staging_dir("bench");
+            installer.extract_zip(zip_file, staging_dir, threads);
+            store.add_release("bench", staging_dir, threads);
+
+            runner.run(hardlinks ? "store_materialize_hardlinks" : "store_materialize", zip_uncompressed,
+                       [&] { fs::remove_all(extract_dir); },
+                       [&] { store.materialize("bench", extract_dir, threads); });
+        }
+
+        // full installs against the local stand-in server: API call, download,
+        // extraction and the registry patch, with bandwidth, latency and
+        // connection resets injected on the server side
+        std::string zip_data = read_file(zip_file);
+        fs::path wine_prefix = workdir / "prefix";
+        fs::path wine_gd_dir = workdir / "gd";
+        fs::path steam_prefix = home / "library3" / "steamapps" / "compatdata" / "322170" / "pfx";
+        fs::path steam_gd_dir = home / "library3" / "steamapps" / "common" / "Geometry Dash";
+
+        // the disk path keeps verified archives here, every run has to download again
+        auto clear_release_cache = [&](const std::string& tag) {
+            fs::remove(cache_dir / "geode-installer" / ("geode-" + tag + "-win.zip"));
+        };
+
+        // options pointed at a stand-in server, with neither the tag nor the
+        // archive cached, and an empty game directory next to a prefix that
+        // holds the fixture user.reg
+        auto prepare_install = [&](InstallerOptions options, const StandInServer& server, const std::string& tag,
+                                   bool steam = false) {
+            options.api_base_url = server.get_base_url();
+            options.release_base_url = server.get_base_url();
+            options.github_api_base_url = server.get_base_url();
+            options.metadata_ttl = std::chrono::seconds(0);
+
+            InstallFixture fixture{options, steam ? steam_prefix : wine_prefix, steam ? steam_gd_dir : wine_gd_dir};
+
+            clear_release_cache(tag);
+            fs::remove_all(fixture.gd_dir);
+            fs::create_directories(fixture.gd_dir);
+            fs::create_directories(fixture.prefix);
+            fs::copy_file(reg_fixture, fixture.prefix / "user.reg", fs::copy_options::overwrite_existing);
+            return fixture;
+        };
+
+        // with a mirror config a second server is added as a release and api
+        // mirror, the check then is whether the mirror did its share
+        auto run_install = [&](const std::string& name, StandInServerConfig config, InstallerOptions options,
+                               bool steam = false, std::optional<StandInServerConfig> mirror_config = std::nullopt) {
+            const fs::path& gd_dir = steam ? steam_gd_dir : wine_gd_dir;
+
+            config.zip_data = zip_data;
+            size_t expected_resets = config.resets;
+            if (mirror_config) {
+                mirror_config->zip_data = zip_data;
+            }
+
+            std::optional<StandInServer> server;
+            std::optional<StandInServer> mirror;
+            std::unique_ptr<GeodeInstaller> network_installer;
+
+            auto setup = [&] {
+                network_installer.reset();
+                server.reset();
+                mirror.reset();
+                server.emplace(config);
+
+                InstallFixture fixture = prepare_install(options, *server, config.tag, steam);
+                if (mirror_config) {
+                    mirror.emplace(*mirror_config);
+                    fixture.options.api_mirrors.push_back(mirror->get_base_url());
+                    fixture.options.release_mirrors.push_back(mirror->get_base_url());
+                }
+                network_installer = std::make_unique<GeodeInstaller>(fixture.options);
+            };
+
+            runner.run(name, zip_data.size(), setup, [&] {
+                if (steam) {
+                    network_installer->install_geode_to_steam();
+                } else {
+                    network_installer->install_geode_to_wine(wine_prefix, gd_dir);
+                }
+
+                if (file_size_or_zero(gd_dir / "Geode.dll") == 0 || fs::exists(gd_dir / "geode_win.zip")) {
+                    throw std::runtime_error(name + ": install did not produce the expected files");
+                }
+                if (mirror) {
+                    // the primary's resets depend on how many ranges it got before
+                    // the switch, only that the mirror took over is fixed
+                    if (mirror->get_archive_bytes() < zip_data.size() / 2) {
+                        throw std::runtime_error(name + ": mirror served only " +
+                                                 std::to_string(mirror->get_archive_bytes()) + " of " +
+                                                 std::to_string(zip_data.size()) + " archive bytes");
+                    }
+                } else if (server->get_reset_count() != expected_resets) {
+                    throw std::runtime_error(name + ": expected " + std::to_string(expected_resets) +
+                                             " connection resets, saw " + std::to_string(server->get_reset_count()));
+                }
+            });
+        };
+
+        InstallerOptions stream_options;
+        InstallerOptions segmented_options;
+        segmented_options.stream_extract = false;
+
+        StandInServerConfig unlimited;
+        StandInServerConfig throttled;
+        throttled.bandwidth = 32 * 1024 * 1024;
+        throttled.latency = std::chrono::milliseconds(20);
+
+        // ranges get cut a few times, segments have to retry from where they stopped
+        StandInServerConfig flaky = throttled;
+        flaky.reset_after = 512 * 1024;
+        flaky.resets = 3;
+
+        StandInServerConfig no_ranges = throttled;
+        no_ranges.ranges = false;
+
+        run_install("install_stream_local", unlimited, stream_options);
+        run_install("install_segmented_local", unlimited, segmented_options);
+        run_install("install_stream_throttled", throttled, stream_options);
+        run_install("install_segmented_throttled", throttled, segmented_options);
+        run_install("install_segmented_with_resets", flaky, segmented_options);
+        run_install("install_without_ranges", no_ranges, segmented_options);
+
+        // Steam discovery overlapped with the tag lookup and the download
+        run_install("install_steam_stream_throttled", throttled, stream_options, true);
+        run_install("install_steam_segmented_throttled", throttled, segmented_options, true);
+
+        // the probe has to pick the fast mirror over the slow primary
+        StandInServerConfig slow_primary;
+        slow_primary.bandwidth = 2 * 1024 * 1024;
+        run_install("install_mirrors_slow_primary", slow_primary, stream_options, false, unlimited);
+        run_install("install_mirrors_slow_primary_segmented", slow_primary, segmented_options, false, unlimited);
+
+        // the primary wins the probe but cuts every download short, the rest
+        // has to come from the mirror from where the primary stopped
+        StandInServerConfig dropping_primary;
+        dropping_primary.reset_after = 1024 * 1024;
+        dropping_primary.resets = std::numeric_limits<size_t>::max();
+        StandInServerConfig late_mirror;
+        late_mirror.latency = std::chrono::milliseconds(100);
+        run_install("install_mirrors_primary_resets", dropping_primary, stream_options, false, late_mirror);
+        run_install("install_mirrors_primary_resets_segmented", dropping_primary, segmented_options, false, late_mirror);
+
+        // an update where XInput1_4.dll and a few resources changed, only
+        // those should come over the wire
+        {
+            StandInServerConfig config = throttled;
+            config.zip_data = zip_data;
+            StandInServer server(config);
+
+            InstallFixture fixture = prepare_install(stream_options, server, config.tag);
+            fixture.options.partial_update = true;
+            GeodeInstaller updating_installer(fixture.options);
+            updating_installer.install_geode_to_wine(wine_prefix, wine_gd_dir);
+
+            std::vector<fs::path> changed = {wine_gd_dir / "XInput1_4.dll"};
+            for (int i = 0; i < 2000; i += 100) {
+                fs::path resource = wine_gd_dir / "geode" / "resources" / "geode.loader" /
+                                    ("res" + std::to_string(i) + (i % 3 ? ".png" : ".plist"));
+                if (fs::exists(resource)) {
+                    changed.push_back(resource);
+                }
+            }
+
+            uint64_t archive_bytes = 0;
+            runner.run("install_partial_update", zip_data.size(), [&] {
+                for (const auto& path : changed) {
+                    std::ofstream(path, std::ios::trunc) << "previous version";
+                }
+                archive_bytes = server.get_archive_bytes();
+            }, [&] {
+                updating_installer.install_geode_to_wine(wine_prefix, wine_gd_dir);
+
+                uint64_t fetched = server.get_archive_bytes() - archive_bytes;
+                if (fetched > zip_data.size() / 4) {
+                    throw std::runtime_error("install_partial_update: fetched " + std::to_string(fetched) + " of " +
+                                             std::to_string(zip_data.size()) + " archive bytes");
+                }
+                if (file_size_or_zero(wine_gd_dir / "XInput1_4.dll") != 512 * 1024) {
+                    throw std::runtime_error("install_partial_update: XInput1_4.dll was not updated");
+                }
+            });
+        }
+
+        // the same install with an NDJSON event stream attached, every phase
+        // has to start and end, and the download has to account for the whole zip
+        {
+            StandInServerConfig config = throttled;
+            config.zip_data = zip_data;
+            StandInServer server(config);
+
+            GeodeInstaller reporting_installer(prepare_install(stream_options, server, config.tag).options);
+
+            fs::path events_path = workdir / "progress.ndjson";
+
+            runner.run("install_stream_progress_events", zip_data.size(), [&] {
+                prepare_install(stream_options, server, config.tag);
+            }, [&] {
+                int fd = open(events_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fd < 0) {
+                    throw std::runtime_error("install_stream_progress_events: failed to open " + events_path.string());
+                }
+                {
+                    ProgressSession session(false, fd);
+                    reporting_installer.install_geode_to_wine(wine_prefix, wine_gd_dir);
+                }
+                close(fd);
+
+                std::map<std::string, Json::Value> ends;
+                std::map<std::string, int> starts;
+                std::istringstream events(read_file(events_path));
+                std::string line;
+                while (std::getline(events, line)) {
+                    Json::Value event;
+                    Json::Reader reader;
+                    if (!reader.parse(line, event)) {
+                        throw std::runtime_error("install_stream_progress_events: invalid event " + line);
+                    }
+                    if (event["event"].asString() == "start") {
+                        starts[event["phase"].asString()]++;
+                    } else if (event["event"].asString() == "end") {
+                        ends[event["phase"].asString()] = event;
+                    }
+                }
+
+                if (starts["download"] != 1 || starts["extract"] != 1 ||
+                    ends["download"]["bytes"].asUInt64() != zip_data.size() ||
+                    ends["extract"]["items"].asUInt64() == 0) {
+                    throw std::runtime_error("install_stream_progress_events: missing or incomplete phases");
+                }
+            });
+        }
+
+        // checking an install from its manifest is a stat per file, only the
+        // touched XInput1_4.dll gets hashed. then the damage has to be found and
+        // the uninstall has to leave nothing behind
+        {
+            StandInServerConfig config = unlimited;
+            config.zip_data = zip_data;
+            StandInServer server(config);
+
+            GeodeInstaller verifying_installer(prepare_install(stream_options, server, config.tag).options);
+            verifying_installer.install_geode_to_wine(wine_prefix, wine_gd_dir);
+
+            fs::path touched = wine_gd_dir / "XInput1_4.dll";
+            runner.run("verify_install", 0, [&] {
+                fs::last_write_time(touched, fs::file_time_type::clock::now());
+            }, [&] {
+                VerifyResult result = verifying_installer.verify_install(wine_gd_dir);
+                if (!result.intact() || result.hashed != 1) {
+                    throw std::runtime_error("verify_install: an intact install was not reported as intact");
+                }
+            });
+
+            std::ofstream(touched, std::ios::binary | std::ios::in | std::ios::out) << "MZ-modified";
+            fs::remove(wine_gd_dir / "Geode.dll");
+            VerifyResult damaged = verifying_installer.verify_install(wine_gd_dir);
+            if (damaged.modified.size() != 1 || damaged.missing.size() != 1) {
+                throw std::runtime_error("verify_install: a modified and a missing file were not both reported");
+            }
+
+            UninstallResult removed = verifying_installer.uninstall(wine_gd_dir);
+            if (removed.reverted_registry != 1 || fs::exists(wine_gd_dir / "geode") ||
+                fs::exists(InstallManifest::path_in(wine_gd_dir)) ||
+                read_file(wine_prefix / "user.reg").find("\"xinput1_4\"") != std::string::npos) {
+                throw std::runtime_error("uninstall: files or the xinput1_4 override were left behind");
+            }
+        }
+
+        // a zip that doesn't match the published digest must never reach the
+        // game directory, whether it is streamed or downloaded first
+        StandInServerConfig corrupt_digest = unlimited;
+        corrupt_digest.zip_data = zip_data;
+        corrupt_digest.corrupt_digest = true;
+        for (const InstallerOptions* mode : {&stream_options, &segmented_options}) {
+            StandInServer server(corrupt_digest);
+
+            GeodeInstaller rejecting_installer(prepare_install(*mode, server, corrupt_digest.tag).options);
+
+            bool rejected = false;
+            try {
+                rejecting_installer.install_geode_to_wine(wine_prefix, wine_gd_dir);
+            } catch (const std::runtime_error& e) {
+                rejected = std::string(e.what()).find("Checksum mismatch") != std::string::npos;
+            }
+
+            if (!rejected || fs::exists(wine_gd_dir / "Geode.dll") || !fs::is_empty(wine_gd_dir)) {
+                throw std::runtime_error(std::string("A release zip with a wrong checksum was not rejected (") +
+                                         (mode->stream_extract ? "streamed" : "segmented") + ")");
+            }
+        }
+
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "  ";
+        std::string json = Json::writeString(writer, runner.to_json());
+
+        std::cout.rdbuf(stdout_buffer);
+        std::cout.clear();
+
+        if (output_path.empty()) {
+            std::cout << json << std::endl;
+        } else {
+            std::ofstream output(output_path, std::ios::trunc);
+            output << json << std::endl;
+            if (!output) {
+                throw std::runtime_error("Failed to write benchmark results: " + output_path.string());
+            }
+        }
+
+        fs::remove_all(workdir);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
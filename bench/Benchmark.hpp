@@ -0,0 +1,44 @@
+#pragma once
+
+#include <json/json.h>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// bumped by the operator new replacement in BenchMain.cpp
+extern std::atomic<uint64_t> g_allocation_count;
+extern std::atomic<uint64_t> g_allocated_bytes;
+
+struct BenchResult {
+    std::string name;
+    size_t iterations = 0;
+    double mean_ms = 0;
+    double min_ms = 0;
+    double max_ms = 0;
+    uint64_t bytes_per_iteration = 0;
+    double throughput_mb_s = 0;
+    double allocations_per_iteration = 0;
+    double allocated_bytes_per_iteration = 0;
+};
+
+class BenchRunner {
+public:
+    BenchRunner(size_t iterations, std::string filter);
+
+    // setup runs before every iteration and is neither timed nor counted
+    void run(const std::string& name, uint64_t bytes_per_iteration,
+             const std::function<void()>& setup, const std::function<void()>& body);
+
+    void run(const std::string& name, uint64_t bytes_per_iteration, const std::function<void()>& body) {
+        run(name, bytes_per_iteration, [] {}, body);
+    }
+
+    Json::Value to_json() const;
+
+private:
+    size_t iterations_;
+    std::string filter_;
+    std::vector<BenchResult> results_;
+};
@@ -0,0 +1,237 @@
+#include "Fixtures.hpp"
+#include <zip.h>
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static std::string make_text(std::mt19937& rng, size_t size) {
+    static const char* words[] = {
+        "geode", "loader", "mod", "layer", "node", "sprite", "texture", "level", "player", "cocos",
+        "return", "void", "class", "struct", "const", "static", "inline", "template", "0x1f", "{}",
+    };
+
+    std::string text;
+    text.reserve(size + 16);
+    while (text.size() < size) {
+        text += words[rng() % 20];
+        text += rng() % 8 == 0 ? '\n' : ' ';
+    }
+    text.resize(size);
+    return text;
+}
+
+static std::string make_binary(std::mt19937& rng, size_t size) {
+    // half noise, half text so it compresses roughly like a real DLL
+    std::string data = make_text(rng, size / 2);
+    data.reserve(size);
+    while (data.size() < size) {
+        uint32_t value = rng();
+        data.append(reinterpret_cast<const char*>(&value), std::min<size_t>(sizeof(value), size - data.size()));
+    }
+    return data;
+}
+
+static std::string make_appmanifest(const std::string& app_id, const std::string& installdir) {
+    std::ostringstream acf;
+    acf << "\"AppState\"\n{\n"
+        << "\t\"appid\"\t\t\"" << app_id << "\"\n"
+        << "\t\"Universe\"\t\t\"1\"\n"
+        << "\t\"LauncherPath\"\t\t\"/home/user/.local/share/Steam/ubuntu12_32/steam\"\n"
+        << "\t\"name\"\t\t\"Game " << app_id << "\"\n"
+        << "\t\"StateFlags\"\t\t\"4\"\n"
+        << "\t\"installdir\"\t\t\"" << installdir << "\"\n"
+        << "\t\"LastUpdated\"\t\t\"1700000000\"\n"
+        << "\t\"SizeOnDisk\"\t\t\"123456789\"\n"
+        << "\t\"buildid\"\t\t\"13590000\"\n"
+        << "\t\"InstalledDepots\"\n\t{\n";
+    for (int depot = 1; depot <= 4; depot++) {
+        acf << "\t\t\"" << app_id << depot << "\"\n\t\t{\n"
+            << "\t\t\t\"manifest\"\t\t\"84736251908273645" << depot << "\"\n"
+            << "\t\t\t\"size\"\t\t\"5000000" << depot << "\"\n\t\t}\n";
+    }
+    acf << "\t}\n"
+        << "\t\"UserConfig\"\n\t{\n\t\t\"language\"\t\t\"english\"\n\t}\n"
+        << "\t\"MountedConfig\"\n\t{\n\t\t\"language\"\t\t\"english\"\n\t}\n"
+        << "}\n";
+    return acf.str();
+}
+
+static void write_file(const fs::path& path, const std::string& content) {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+    if (!file) {
+        throw std::runtime_error("Failed to write fixture: " + path.string());
+    }
+}
+
+void generate_steam_tree(const fs::path& home, size_t libraries, size_t apps_per_library) {
+    fs::path steam_root = home / ".steam" / "steam";
+    std::vector<fs::path> library_roots = {steam_root};
+    for (size_t i = 1; i < libraries; i++) {
+        library_roots.push_back(home / ("library" + std::to_string(i)));
+    }
+
+    std::ostringstream vdf;
+    vdf << "\"libraryfolders\"\n{\n";
+
+    uint32_t next_app_id = 400000;
+
+    for (size_t library = 0; library < library_roots.size(); library++) {
+        fs::path steamapps = library_roots[library] / "steamapps";
+        fs::create_directories(steamapps / "common");
+
+        vdf << "\t\"" << library << "\"\n\t{\n"
+            << "\t\t\"path\"\t\t\"" << library_roots[library].string() << "\"\n"
+            << "\t\t\"label\"\t\t\"\"\n"
+            << "\t\t\"contentid\"\t\t\"1234567890" << library << "\"\n"
+            << "\t\t\"totalsize\"\t\t\"0\"\n"
+            << "\t\t\"apps\"\n\t\t{\n";
+
+        for (size_t app = 0; app < apps_per_library; app++) {
+            std::string app_id = std::to_string(next_app_id++);
+            std::string installdir = "Game " + app_id;
+
+            write_file(steamapps / ("appmanifest_" + app_id + ".acf"), make_appmanifest(app_id, installdir));
+            fs::create_directories(steamapps / "common" / installdir);
+            vdf << "\t\t\t\"" << app_id << "\"\t\t\"123456789\"\n";
+        }
+
+        if (library + 1 == library_roots.size()) {
+            write_file(steamapps / "appmanifest_322170.acf", make_appmanifest("322170", "Geometry Dash"));
+            fs::create_directories(steamapps / "common" / "Geometry Dash");
+            fs::create_directories(steamapps / "compatdata" / "322170" / "pfx");
+            vdf << "\t\t\t\"322170\"\t\t\"300000000\"\n";
+        }
+
+        vdf << "\t\t}\n\t}\n";
+    }
+
+    vdf << "}\n";
+    write_file(steam_root / "steamapps" / "libraryfolders.vdf", vdf.str());
+}
+
+size_t generate_wine_prefixes(const fs::path& home, size_t prefixes) {
+    const fs::path roots[] = {
+        home / ".local" / "share" / "wineprefixes",
+        home / "Games",
+        home / ".local" / "share" / "bottles" / "bottles",
+        home / "Games" / "Heroic" / "Prefixes" / "default",
+    };
+    const char* windows_dirs[] = {"system32", "syswow64", "Fonts", "Installer", "Microsoft.NET", "winsxs"};
+    const char* program_dirs[] = {"Common Files", "Internet Explorer", "Windows Media Player", "Windows NT"};
+
+    size_t games = 0;
+    for (size_t i = 0; i < prefixes; i++) {
+        fs::path prefix = roots[i % 4] / ("prefix-" + std::to_string(i));
+        fs::path drive_c = prefix / "drive_c";
+
+        write_file(prefix / "user.reg", "WINE REGISTRY Version 2\n");
+        write_file(prefix / "system.reg", "WINE REGISTRY Version 2\n");
+        fs::create_directories(prefix / "dosdevices");
+        fs::create_directory_symlink("../drive_c", prefix / "dosdevices" / "c:");
+        fs::create_directory_symlink("/", prefix / "dosdevices" / "z:");
+
+        for (const char* dir : windows_dirs) {
+            for (int j = 0; j < 8; j++) {
+                fs::create_directories(drive_c / "windows" / dir / ("sub" + std::to_string(j)));
+            }
+        }
+        for (const char* dir : program_dirs) {
+            fs::create_directories(drive_c / "Program Files" / dir);
+            fs::create_directories(drive_c / "Program Files (x86)" / dir);
+        }
+        fs::create_directories(drive_c / "users" / "user" / "AppData" / "Local" / "Temp");
+        fs::create_directories(drive_c / "ProgramData" / "Microsoft" / "Windows" / "Start Menu");
+
+        if (i % 10 == 0) {
+            fs::path game = drive_c / "Program Files (x86)" / "Steam" / "steamapps" / "common" / "Geometry Dash";
+            write_file(game / "GeometryDash.exe", "MZ");
+            write_file(game / "libcocos2d.dll", "MZ");
+            fs::create_directories(game / "Resources");
+            games++;
+        }
+    }
+
+    return games;
+}
+
+uint64_t generate_user_reg(const fs::path& path, size_t megabytes) {
+    std::mt19937 rng(1);
+    const size_t target = megabytes * 1024 * 1024;
+
+    std::string content = "WINE REGISTRY Version 2\n;; All keys relative to \\\\User\\\\S-1-5-21-0-0-0-1000\n\n#arch=win64\n";
+    bool overrides_written = false;
+
+    for (size_t section = 0; content.size() < target; section++) {
+        if (!overrides_written && content.size() >= target / 2) {
+            content += "\n[Software\\\\Wine\\\\DllOverrides] 1700000000\n#time=1da0000000000\n"
+                       "\"d3d9\"=\"native\"\n\"dxgi\"=\"native,builtin\"\n";
+            overrides_written = true;
+        }
+
+        content += "\n[Software\\\\Vendor" + std::to_string(section % 97) + "\\\\App" + std::to_string(section) +
+                   "\\\\Settings] 1700000000\n#time=1d9" + std::to_string(section) + "\n";
+
+        for (int value = 0; value < 12; value++) {
+            content += "\"Value" + std::to_string(value) + "\"=\"" + make_text(rng, 24 + rng() % 40) + "\"\n";
+        }
+        content += "\"Blob\"=hex:01,02,03,04,05,06,07,08,09,0a,0b,0c,0d,0e,0f,10,11,12,13,14,15,16,17,18,\\\n"
+                   "  19,1a,1b,1c,1d,1e,1f,20\n";
+    }
+
+    write_file(path, content);
+    return content.size();
+}
+
+uint64_t generate_geode_zip(const fs::path& path) {
+    std::mt19937 rng(2);
+    std::vector<std::pair<std::string, std::string>> entries;
+
+    entries.push_back({"Geode.dll", make_binary(rng, 8 * 1024 * 1024)});
+    entries.push_back({"GeodeUpdater.exe", make_binary(rng, 3 * 1024 * 1024)});
+    entries.push_back({"XInput1_4.dll", make_binary(rng, 512 * 1024)});
+
+    for (int i = 0; i < 400; i++) {
+        std::string name = "geode/resources/geode.loader/res" + std::to_string(i) + (i % 3 ? ".png" : ".plist");
+        entries.push_back({name, i % 3 ? make_binary(rng, 2048 + rng() % 40000) : make_text(rng, 1024 + rng() % 8000)});
+    }
+
+    fs::remove(path);
+
+    int err = 0;
+    zip_t* archive = zip_open(path.string().c_str(), ZIP_CREATE | ZIP_TRUNCATE, &err);
+    if (!archive) {
+        throw std::runtime_error("Failed to create fixture zip: " + path.string());
+    }
+
+    uint64_t total = 0;
+
+    // libzip reads the buffers at zip_close, they must stay alive until then
+    for (const auto& [name, data] : entries) {
+        zip_source_t* source = zip_source_buffer(archive, data.data(), data.size(), 0);
+        zip_int64_t index = source ? zip_file_add(archive, name.c_str(), source, ZIP_FL_OVERWRITE) : -1;
+
+        if (index < 0) {
+            if (source) {
+                zip_source_free(source);
+            }
+            zip_discard(archive);
+            throw std::runtime_error("Failed to add fixture entry: " + name);
+        }
+
+        zip_set_file_compression(archive, index, ZIP_CM_DEFLATE, 6);
+        total += data.size();
+    }
+
+    if (zip_close(archive) != 0) {
+        zip_discard(archive);
+        throw std::runtime_error("Failed to write fixture zip: " + path.string());
+    }
+
+    return total;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <filesystem>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// a Steam install under home/.steam/steam with extra libraries next to it.
+// Geometry Dash (322170) and its Proton prefix live in the last library.
+void generate_steam_tree(const fs::path& home, size_t libraries, size_t apps_per_library);
+
+// Wine prefixes spread over the Wine, Lutris, Bottles and Heroic locations
+// under home, each with a skeleton drive_c. every tenth has Geometry Dash
+// installed, returns how many do
+size_t generate_wine_prefixes(const fs::path& home, size_t prefixes);
+
+// a user.reg of roughly the requested size with a DllOverrides section in
+// the middle, returns the real size
+uint64_t generate_user_reg(const fs::path& path, size_t megabytes);
+
+// a zip shaped like geode-win: a few large DLLs plus many small resources,
+// returns the uncompressed size of all entries
+uint64_t generate_geode_zip(const fs::path& path);
@@ -0,0 +1,262 @@
+#include "StandInServer.hpp"
+#include "Sha256.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static constexpr size_t kMaxRequestSize = 64 * 1024;
+static constexpr size_t kSendChunkSize = 16 * 1024;
+
+static bool send_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+static std::string to_lower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+    return value;
+}
+
+// returns the value of a header from the raw request head, or an empty string
+static std::string find_header(const std::string& head, const std::string& name) {
+    std::string lowered = to_lower(head);
+    size_t pos = lowered.find("\r\n" + name + ":");
+    if (pos == std::string::npos) {
+        return {};
+    }
+
+    size_t start = head.find_first_not_of(" \t", pos + name.size() + 3);
+    size_t end = head.find("\r\n", start);
+    return start == std::string::npos ? std::string() : head.substr(start, end - start);
+}
+
+StandInServer::StandInServer(StandInServerConfig config) : config_(std::move(config)) {
+    resets_left_ = config_.resets;
+
+    Sha256 sha;
+    sha.update(config_.zip_data.data(), config_.zip_data.size());
+    zip_digest_ = sha.hex_digest();
+    if (config_.corrupt_digest) {
+        zip_digest_[0] = zip_digest_[0] == '0' ? '1' : '0';
+    }
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error("Failed to create stand-in server socket");
+    }
+
+    int reuse = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    socklen_t length = sizeof(address);
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listen_fd_, 64) != 0 ||
+        getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        close(listen_fd_);
+        throw std::runtime_error("Failed to start stand-in server");
+    }
+
+    port_ = ntohs(address.sin_port);
+    accept_thread_ = std::thread([this]() { accept_loop(); });
+}
+
+StandInServer::~StandInServer() {
+    stopping_ = true;
+    accept_thread_.join();
+
+    for (auto& connection : connections_) {
+        connection.join();
+    }
+
+    close(listen_fd_);
+}
+
+std::string StandInServer::get_base_url() const {
+    return "http://127.0.0.1:" + std::to_string(port_);
+}
+
+void StandInServer::accept_loop() {
+    // polled so the destructor doesn't have to wake a blocking accept
+    while (!stopping_) {
+        pollfd poll_fd{listen_fd_, POLLIN, 0};
+        if (poll(&poll_fd, 1, 50) <= 0) {
+            continue;
+        }
+
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        connections_.emplace_back([this, fd]() { handle_connection(fd); });
+    }
+}
+
+bool StandInServer::send_body(int fd, const char* data, uint64_t size, bool allow_reset, bool archive) {
+    uint64_t limit = allow_reset ? std::min(size, config_.reset_after) : size;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sent = 0;
+
+    while (sent < limit) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(kSendChunkSize, limit - sent));
+        if (!send_all(fd, data + sent, chunk)) {
+            return true;
+        }
+        sent += chunk;
+        if (archive) {
+            archive_bytes_ += chunk;
+        }
+
+        if (config_.bandwidth > 0) {
+            auto due = start + std::chrono::microseconds(sent * 1000000 / config_.bandwidth);
+            std::this_thread::sleep_until(due);
+        }
+    }
+
+    if (sent < size) {
+        // a zero linger timeout makes close send RST instead of FIN
+        linger reset{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        reset_count_++;
+        return false;
+    }
+    return true;
+}
+
+void StandInServer::handle_connection(int fd) {
+    std::string head;
+    char buffer[4096];
+
+    while (head.find("\r\n\r\n") == std::string::npos && head.size() < kMaxRequestSize) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            close(fd);
+            return;
+        }
+        head.append(buffer, received);
+    }
+
+    request_count_++;
+
+    size_t method_end = head.find(' ');
+    size_t path_end = head.find(' ', method_end + 1);
+    std::string method = head.substr(0, method_end);
+    std::string path = method_end == std::string::npos ? "" : head.substr(method_end + 1, path_end - method_end - 1);
+
+    if (config_.latency.count() > 0) {
+        std::this_thread::sleep_for(config_.latency);
+    }
+
+    std::string zip_path = "/" + config_.tag + "/geode-" + config_.tag + "-win.zip";
+    std::string status = "200 OK";
+    std::string headers;
+    std::string body;
+    const char* body_data = nullptr;
+    uint64_t body_size = 0;
+    bool archive = false;
+
+    if (path == "/v1/loader/versions/latest") {
+        body = "{\"error\":\"\",\"payload\":{\"tag\":\"" + config_.tag + "\"}}";
+        headers += "Content-Type: application/json\r\n";
+    } else if (path == "/releases/tags/" + config_.tag) {
+        body = "{\"tag_name\":\"" + config_.tag + "\",\"assets\":[{\"name\":\"geode-" + config_.tag + "-win.zip\"";
+        if (config_.publish_digest) {
+            body += ",\"digest\":\"sha256:" + zip_digest_ + "\"";
+        }
+        body += "}]}";
+        headers += "Content-Type: application/json\r\n";
+    } else if (path == zip_path) {
+        archive = true;
+        body_data = config_.zip_data.data();
+        body_size = config_.zip_data.size();
+        headers += "Content-Type: application/zip\r\nETag: \"" + config_.tag + "\"\r\n";
+
+        std::string range = find_header(head, "range");
+        if (config_.ranges) {
+            headers += "Accept-Ranges: bytes\r\n";
+        }
+
+        if (config_.ranges && range.rfind("bytes=", 0) == 0) {
+            uint64_t total = config_.zip_data.size();
+            uint64_t first = 0;
+            uint64_t last = total - 1;
+
+            try {
+                size_t dash = range.find('-');
+                if (dash == 6) {
+                    // bytes=-<n>, the last n bytes
+                    first = total - std::min<uint64_t>(std::stoull(range.substr(7)), total);
+                } else {
+                    first = std::stoull(range.substr(6, dash - 6));
+                    if (dash + 1 < range.size()) {
+                        last = std::min<uint64_t>(std::stoull(range.substr(dash + 1)), total - 1);
+                    }
+                }
+            } catch (const std::exception&) {
+                first = total;
+            }
+
+            if (first >= total || first > last) {
+                status = "416 Range Not Satisfiable";
+                headers += "Content-Range: bytes */" + std::to_string(total) + "\r\n";
+                body_data = nullptr;
+                body_size = 0;
+            } else {
+                status = "206 Partial Content";
+                headers += "Content-Range: bytes " + std::to_string(first) + "-" + std::to_string(last) + "/" +
+                           std::to_string(total) + "\r\n";
+                body_data += first;
+                body_size = last - first + 1;
+            }
+        }
+    } else {
+        status = "404 Not Found";
+        body = "not found";
+    }
+
+    if (!body_data) {
+        body_data = body.data();
+        body_size = body.size();
+    }
+
+    std::string response_head = "HTTP/1.1 " + status + "\r\n" + headers +
+                                "Content-Length: " + std::to_string(body_size) + "\r\n" +
+                                "Connection: close\r\n\r\n";
+
+    bool graceful = true;
+
+    if (send_all(fd, response_head.data(), response_head.size()) && method != "HEAD") {
+        bool reset = false;
+        if (archive && config_.reset_after > 0) {
+            size_t left = resets_left_.load();
+            while (left > 0 && !resets_left_.compare_exchange_weak(left, left - 1)) {
+            }
+            reset = left > 0;
+        }
+
+        graceful = send_body(fd, body_data, body_size, reset, archive);
+    }
+
+    if (graceful) {
+        shutdown(fd, SHUT_WR);
+    }
+    close(fd);
+}
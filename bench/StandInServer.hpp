@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+struct StandInServerConfig {
+    // served as the latest loader by /v1/loader/versions/latest
+    std::string tag = "v0.0.0-bench";
+    // served at /<tag>/geode-<tag>-win.zip
+    std::string zip_data;
+    // list the zip's SHA-256 in /releases/tags/<tag> like GitHub does,
+    // or a wrong one to make verification fail
+    bool publish_digest = true;
+    bool corrupt_digest = false;
+
+    // per response, 0 = unlimited
+    uint64_t bandwidth = 0;
+    // delay before every response is sent
+    std::chrono::milliseconds latency{0};
+    // advertise and honor byte ranges
+    bool ranges = true;
+
+    // reset the connection after this many body bytes, for the first
+    // `resets` archive responses
+    uint64_t reset_after = 0;
+    size_t resets = 0;
+};
+
+// a tiny HTTP/1.1 server on 127.0.0.1 standing in for the Geode API, the
+// GitHub releases API and the GitHub release downloads. one thread per
+// connection, every response closes its connection.
+class StandInServer {
+public:
+    explicit StandInServer(StandInServerConfig config);
+    ~StandInServer();
+
+    StandInServer(const StandInServer&) = delete;
+    StandInServer& operator=(const StandInServer&) = delete;
+
+    // http://127.0.0.1:<port>, usable as both api and release base url
+    std::string get_base_url() const;
+
+    size_t get_request_count() const { return request_count_; }
+    size_t get_reset_count() const { return reset_count_; }
+    // release archive body bytes sent, probes and ranges included
+    uint64_t get_archive_bytes() const { return archive_bytes_; }
+
+private:
+    void accept_loop();
+    void handle_connection(int fd);
+
+    // false when the connection was reset on purpose
+    bool send_body(int fd, const char* data, uint64_t size, bool allow_reset, bool archive);
+
+    StandInServerConfig config_;
+    std::string zip_digest_;
+    int listen_fd_ = -1;
+    uint16_t port_ = 0;
+
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> request_count_{0};
+    std::atomic<size_t> reset_count_{0};
+    std::atomic<uint64_t> archive_bytes_{0};
+    std::atomic<size_t> resets_left_{0};
+
+    std::thread accept_thread_;
+    std::mutex connections_mutex_;
+    std::vector<std::thread> connections_;
+};
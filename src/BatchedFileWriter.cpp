@@ -0,0 +1,479 @@
+#include "BatchedFileWriter.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef GEODE_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+// writers block submit() beyond this much queued file data
+static constexpr size_t kMaxQueuedBytes = 64 * 1024 * 1024;
+// files per io_uring round trip, each takes up to two SQEs at once
+static constexpr size_t kBatchSize = 64;
+static constexpr size_t kPoolThreads = 4;
+// a single write SQE is capped below 2GB, longer files take several rounds
+static constexpr size_t kMaxWriteSize = 1024 * 1024 * 1024;
+static constexpr size_t kCopyChunkSize = 1024 * 1024;
+
+static constexpr int kOpenFlags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+BatchedFileWriter::BatchedFileWriter(const fs::path& root) : root_(root) {
+    fs::create_directories(root_);
+
+    root_fd_ = open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd_ < 0) {
+        throw std::runtime_error("Failed to open directory: " + root_.string());
+    }
+
+#ifdef GEODE_HAVE_IO_URING
+    // seccomp filters and older kernels can refuse the ring or some of its
+    // opcodes, then the thread pool takes over
+    ring_ = new io_uring;
+    bool usable = io_uring_queue_init(kBatchSize * 2, ring_, 0) == 0;
+
+    if (usable) {
+        io_uring_probe* probe = io_uring_get_probe_ring(ring_);
+        usable = probe && io_uring_opcode_supported(probe, IORING_OP_OPENAT) &&
+                 io_uring_opcode_supported(probe, IORING_OP_FALLOCATE) &&
+                 io_uring_opcode_supported(probe, IORING_OP_WRITE) &&
+                 io_uring_opcode_supported(probe, IORING_OP_CLOSE);
+        if (probe) {
+            io_uring_free_probe(probe);
+        }
+        if (!usable) {
+            io_uring_queue_exit(ring_);
+        }
+    }
+
+    if (!usable) {
+        delete ring_;
+        ring_ = nullptr;
+    }
+#endif
+
+    if (ring_) {
+        threads_.emplace_back([this]() { run_io_uring(); });
+    } else {
+        for (size_t i = 0; i < kPoolThreads; i++) {
+            threads_.emplace_back([this]() { run_pool_worker(); });
+        }
+    }
+}
+
+BatchedFileWriter::~BatchedFileWriter() {
+    // abandoned before finish(), whatever is queued still gets written
+    // but errors are dropped
+    if (!threads_.empty()) {
+        try {
+            finish();
+        } catch (...) {
+        }
+    }
+
+#ifdef GEODE_HAVE_IO_URING
+    if (ring_) {
+        io_uring_queue_exit(ring_);
+        delete ring_;
+    }
+#endif
+
+    if (root_fd_ >= 0) {
+        close(root_fd_);
+    }
+}
+
+void BatchedFileWriter::submit(std::string relative_path, std::vector<char> contents) {
+    std::unique_lock lock(queue_mutex_);
+
+    // one oversized file still goes through once the queue has drained
+    queue_changed_.wait(lock, [&]() {
+        return error_ || closing_ || queued_bytes_ == 0 || queued_bytes_ + contents.size() <= kMaxQueuedBytes;
+    });
+
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+    if (closing_) {
+        throw std::runtime_error("File writer is already finished");
+    }
+
+    queued_bytes_ += contents.size();
+    queue_.push_back({std::move(relative_path), std::move(contents)});
+    queue_changed_.notify_all();
+}
+
+void BatchedFileWriter::create_directory(const std::string& relative_path) {
+    std::string path = relative_path;
+    while (!path.empty() && path.back() == '/') {
+        path.pop_back();
+    }
+    if (!path.empty()) {
+        ensure_directory(path);
+    }
+}
+
+void BatchedFileWriter::finish() {
+    {
+        std::lock_guard lock(queue_mutex_);
+        closing_ = true;
+    }
+    queue_changed_.notify_all();
+
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+    threads_.clear();
+
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+bool BatchedFileWriter::pop_files(std::vector<PendingFile>& files, size_t max_files) {
+    files.clear();
+
+    std::unique_lock lock(queue_mutex_);
+    queue_changed_.wait(lock, [&]() { return !queue_.empty() || closing_; });
+
+    if (queue_.empty()) {
+        return false;
+    }
+
+    while (!queue_.empty() && files.size() < max_files) {
+        files.push_back(std::move(queue_.front()));
+        queue_.pop_front();
+    }
+    return true;
+}
+
+void BatchedFileWriter::files_done(const std::vector<PendingFile>& files) {
+    {
+        std::lock_guard lock(queue_mutex_);
+        for (const auto& file : files) {
+            queued_bytes_ -= file.contents.size();
+        }
+    }
+    queue_changed_.notify_all();
+}
+
+void BatchedFileWriter::record_error(std::exception_ptr error) {
+    {
+        std::lock_guard lock(queue_mutex_);
+        if (!error_) {
+            error_ = error;
+        }
+    }
+    queue_changed_.notify_all();
+}
+
+bool BatchedFileWriter::failed() {
+    std::lock_guard lock(queue_mutex_);
+    return error_ != nullptr;
+}
+
+void BatchedFileWriter::ensure_directory(const std::string& relative_path) {
+    std::lock_guard lock(directories_mutex_);
+
+    if (directories_.count(relative_path)) {
+        return;
+    }
+
+    // walk down from the first component, every level is created once
+    size_t end = 0;
+    while (end != std::string::npos) {
+        end = relative_path.find('/', end + 1);
+        std::string prefix = relative_path.substr(0, end);
+
+        if (!directories_.insert(prefix).second) {
+            continue;
+        }
+        if (mkdirat(root_fd_, prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            directories_.erase(prefix);
+            throw std::runtime_error("Failed to create directory: " + (root_ / prefix).string());
+        }
+    }
+}
+
+void BatchedFileWriter::ensure_parent(const std::string& relative_path) {
+    size_t slash = relative_path.rfind('/');
+    if (slash != std::string::npos && slash > 0) {
+        ensure_directory(relative_path.substr(0, slash));
+    }
+}
+
+void BatchedFileWriter::run_pool_worker() {
+    std::vector<PendingFile> files;
+
+    while (pop_files(files, 1)) {
+        // after a failure the rest is only drained
+        if (!failed()) {
+            try {
+                write_with_pwrite(files.front());
+            } catch (...) {
+                record_error(std::current_exception());
+            }
+        }
+        files_done(files);
+    }
+}
+
+void BatchedFileWriter::write_with_pwrite(const PendingFile& file) {
+    ensure_parent(file.path);
+
+    int fd = openat(root_fd_, file.path.c_str(), kOpenFlags, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create output file: " + (root_ / file.path).string());
+    }
+
+    const char* data = file.contents.data();
+    size_t size = file.contents.size();
+
+    // one extent up front instead of growing the file write by write. not
+    // every filesystem supports it, which is fine
+    if (size > 0) {
+        posix_fallocate(fd, 0, static_cast<off_t>(size));
+    }
+
+    size_t written = 0;
+    while (written < size) {
+        ssize_t result = pwrite(fd, data + written, size - written, static_cast<off_t>(written));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            close(fd);
+            throw std::runtime_error("Failed to write output file: " + (root_ / file.path).string());
+        }
+        written += static_cast<size_t>(result);
+    }
+
+    if (close(fd) != 0) {
+        throw std::runtime_error("Failed to write output file: " + (root_ / file.path).string());
+    }
+}
+
+void BatchedFileWriter::copy_range(const std::string& relative_path, int source_fd, uint64_t offset, uint64_t size) {
+    ensure_parent(relative_path);
+
+    int fd = openat(root_fd_, relative_path.c_str(), kOpenFlags, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to create output file: " + (root_ / relative_path).string());
+    }
+
+    if (size > 0) {
+        posix_fallocate(fd, 0, static_cast<off_t>(size));
+    }
+
+    // plain pread/pwrite when the filesystems can't copy between each other
+    bool use_copy_file_range = true;
+    std::vector<char> buffer;
+    off_t source_offset = static_cast<off_t>(offset);
+    off_t target_offset = 0;
+
+    while (static_cast<uint64_t>(target_offset) < size) {
+        size_t length = static_cast<size_t>(std::min<uint64_t>(size - target_offset, kCopyChunkSize));
+        ssize_t copied;
+        if (use_copy_file_range) {
+            copied = copy_file_range(source_fd, &source_offset, fd, &target_offset, length, 0);
+            if (copied < 0 && target_offset == 0 &&
+                (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                use_copy_file_range = false;
+                buffer.resize(kCopyChunkSize);
+                continue;
+            }
+        } else {
+            copied = pread(source_fd, buffer.data(), length, source_offset);
+            if (copied > 0 && pwrite(fd, buffer.data(), copied, target_offset) != copied) {
+                copied = -1;
+            }
+            if (copied > 0) {
+                source_offset += copied;
+                target_offset += copied;
+            }
+        }
+
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            close(fd);
+            throw std::runtime_error("Failed to write output file: " + (root_ / relative_path).string());
+        }
+    }
+
+    if (close(fd) != 0) {
+        throw std::runtime_error("Failed to write output file: " + (root_ / relative_path).string());
+    }
+}
+
+void BatchedFileWriter::run_io_uring() {
+    std::vector<PendingFile> batch;
+
+    while (pop_files(batch, kBatchSize)) {
+        // after a failure the rest is only drained
+        if (!failed()) {
+            try {
+                write_batch_io_uring(batch);
+            } catch (...) {
+                record_error(std::current_exception());
+            }
+        }
+        files_done(batch);
+    }
+}
+
+#ifdef GEODE_HAVE_IO_URING
+
+// the fallocate half of a linked pair is told apart by this bit
+static constexpr uint64_t kFallocateTag = uint64_t(1) << 62;
+
+static io_uring_sqe* next_sqe(io_uring* ring) {
+    io_uring_sqe* sqe = io_uring_get_sqe(ring);
+    if (!sqe) {
+        throw std::runtime_error("io_uring submission queue is full");
+    }
+    return sqe;
+}
+
+// submits everything queued and hands each of the `count` completions to on_completion
+template <typename Callback>
+static void complete_all(io_uring* ring, size_t count, Callback&& on_completion) {
+    if (count == 0) {
+        return;
+    }
+
+    int submitted = io_uring_submit_and_wait(ring, static_cast<unsigned>(count));
+    if (submitted < 0) {
+        throw std::runtime_error("Failed to submit to io_uring");
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        io_uring_cqe* cqe;
+        int ret = io_uring_wait_cqe(ring, &cqe);
+        if (ret < 0) {
+            throw std::runtime_error("Failed to wait for io_uring completion");
+        }
+
+        uint64_t data = reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe));
+        int result = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+
+        on_completion(data, result);
+    }
+}
+
+void BatchedFileWriter::write_batch_io_uring(std::vector<PendingFile>& batch) {
+    TraceSpan span("write_batch", "extract");
+    span.set_arg("files", static_cast<double>(batch.size()));
+
+    std::vector<int> fds(batch.size(), -1);
+    std::vector<size_t> written(batch.size(), 0);
+    std::string error;
+
+    // directories first, the opens below only resolve paths
+    for (const auto& file : batch) {
+        ensure_parent(file.path);
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        io_uring_sqe* sqe = next_sqe(ring_);
+        io_uring_prep_openat(sqe, root_fd_, batch[i].path.c_str(), kOpenFlags, 0644);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+    }
+
+    complete_all(ring_, batch.size(), [&](uint64_t i, int result) {
+        if (result < 0) {
+            if (error.empty()) {
+                error = "Failed to create output file: " + (root_ / batch[i].path).string();
+            }
+            return;
+        }
+        fds[i] = result;
+    });
+
+    // every file gets its final size allocated and then written, linked so
+    // the write only starts once the allocation is done. a short write is
+    // resubmitted from where it stopped
+    bool first_round = true;
+    while (error.empty()) {
+        size_t pending = 0;
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            size_t size = batch[i].contents.size();
+            if (written[i] == size) {
+                continue;
+            }
+
+            if (first_round) {
+                io_uring_sqe* sqe = next_sqe(ring_);
+                io_uring_prep_fallocate(sqe, fds[i], 0, 0, static_cast<off_t>(size));
+                io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(i | kFallocateTag)));
+                // a failed fallocate must not cancel the write behind it
+                io_uring_sqe_set_flags(sqe, IOSQE_IO_HARDLINK);
+                pending++;
+            }
+
+            size_t length = std::min(size - written[i], kMaxWriteSize);
+            io_uring_sqe* sqe = next_sqe(ring_);
+            io_uring_prep_write(sqe, fds[i], batch[i].contents.data() + written[i], static_cast<unsigned>(length),
+                                written[i]);
+            io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+            pending++;
+        }
+
+        if (pending == 0) {
+            break;
+        }
+        first_round = false;
+
+        complete_all(ring_, pending, [&](uint64_t data, int result) {
+            if (data & kFallocateTag) {
+                return;
+            }
+            if (result == -EINTR || result == -EAGAIN) {
+                return;
+            }
+            if (result <= 0) {
+                if (error.empty()) {
+                    error = "Failed to write output file: " + (root_ / batch[data].path).string();
+                }
+                return;
+            }
+            written[data] += static_cast<size_t>(result);
+        });
+    }
+
+    size_t closes = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (fds[i] < 0) {
+            continue;
+        }
+        io_uring_sqe* sqe = next_sqe(ring_);
+        io_uring_prep_close(sqe, fds[i]);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(i)));
+        closes++;
+    }
+
+    complete_all(ring_, closes, [&](uint64_t i, int result) {
+        if (result < 0 && error.empty()) {
+            error = "Failed to write output file: " + (root_ / batch[i].path).string();
+        }
+    });
+
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+}
+
+#else
+
+void BatchedFileWriter::write_batch_io_uring(std::vector<PendingFile>&) {
+    throw std::runtime_error("Built without io_uring support");
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "CacheDir.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+fs::path get_cache_dir() {
+    const char* xdg_cache_home = getenv("XDG_CACHE_HOME");
+    if (xdg_cache_home && *xdg_cache_home) {
+        return fs::path(xdg_cache_home) / "geode-installer";
+    }
+
+    const char* home = getenv("HOME");
+    if (!home || !*home) {
+        throw std::runtime_error("Neither XDG_CACHE_HOME nor HOME is set");
+    }
+
+    return fs::path(home) / ".cache" / "geode-installer";
+}
+
+bool write_file_atomically(const fs::path& path, const std::string& contents) {
+    static std::atomic<size_t> counter{0};
+
+    std::error_code ec;
+    if (path.has_parent_path()) {
+        fs::create_directories(path.parent_path(), ec);
+        if (ec) {
+            return false;
+        }
+    }
+
+    // unique per writer, threads of one run may save the same file
+    fs::path temp_path = path;
+    temp_path += ".tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+
+    bool written = false;
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (file.is_open()) {
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+            file.flush();
+            written = static_cast<bool>(file);
+        }
+    }
+
+    if (written) {
+        fs::rename(temp_path, path, ec);
+        written = !ec;
+    }
+
+    if (!written) {
+        fs::remove(temp_path, ec);
+    }
+    return written;
+}
@@ -0,0 +1,93 @@
+#include "Checksum.hpp"
+#include "Sha256.hpp"
+#include <zlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef GEODE_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+uint32_t update_crc32(uint32_t crc, const void* data, size_t size) {
+#ifdef GEODE_HAVE_LIBDEFLATE
+    return libdeflate_crc32(crc, data, size);
+#else
+    return static_cast<uint32_t>(crc32_z(crc, static_cast<const Bytef*>(data), static_cast<z_size_t>(size)));
+#endif
+}
+
+std::optional<uint32_t> crc32_of_file(const fs::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return std::nullopt;
+    }
+
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+    uint32_t crc = update_crc32(0, mapped, static_cast<size_t>(st.st_size));
+    munmap(mapped, st.st_size);
+
+    return crc;
+}
+
+std::optional<std::string> sha256_of_file(const fs::path& path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    Sha256 sha;
+
+    if (st.st_size == 0) {
+        close(fd);
+        return sha.hex_digest();
+    }
+
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return std::nullopt;
+    }
+
+    madvise(mapped, st.st_size, MADV_SEQUENTIAL);
+    sha.update(mapped, static_cast<size_t>(st.st_size));
+    munmap(mapped, st.st_size);
+
+    return sha.hex_digest();
+}
+
+bool file_matches_crc(const fs::path& path, uint64_t size, uint32_t crc) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || static_cast<uint64_t>(st.st_size) != size) {
+        return false;
+    }
+
+    std::optional<uint32_t> file_crc = crc32_of_file(path);
+    return file_crc && *file_crc == crc;
+}
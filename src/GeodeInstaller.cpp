@@ -1,104 +1,263 @@
 #include "GeodeInstaller.hpp"
-#include <curl/curl.h>
+#include "ZipStreamExtractor.hpp"
+#include "ZipFileExtractor.hpp"
+#include "ZipFormat.hpp"
+#include "Parallel.hpp"
+#include "CacheDir.hpp"
+#include "ReleaseCache.hpp"
+#include "Checksum.hpp"
+#include "SegmentedDownloader.hpp"
+#include "WineRegistry.hpp"
+#include "Trace.hpp"
+#include "Sha256Pipeline.hpp"
+#include "BatchedFileWriter.hpp"
+#include "ReleaseStore.hpp"
+#include "MirrorSelector.hpp"
+#include "RemoteZip.hpp"
+#include "Progress.hpp"
 #include <zip.h>
 #include <json/json.h>
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 #include <sstream>
 #include <iostream>
 #include <stdexcept>
 #include <chrono>
+#include <exception>
+#include <cctype>
+#include <future>
+#include <unistd.h>
 
-static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* userp) {
-    userp->append((char*)contents, size * nmemb);
-    return size * nmemb;
+GeodeInstaller::GeodeInstaller(InstallerOptions options) : options_(options) {}
+
+const SteamGameFinder& GeodeInstaller::get_finder() const {
+    std::call_once(finder_once_, [this]() { finder_ = std::make_unique<SteamGameFinder>(); });
+    return *finder_;
 }
 
-static size_t WriteFileCallback(void* contents, size_t size, size_t nmemb, FILE* file) {
-    return fwrite(contents, size, nmemb, file);
+// a path that is already known, for the callers that don't overlap anything
+static std::shared_future<fs::path> ready_path(const fs::path& path) {
+    std::promise<fs::path> promise;
+    promise.set_value(path);
+    return promise.get_future().share();
 }
 
-GeodeInstaller::GeodeInstaller() : finder_() {
-    curl_global_init(CURL_GLOBAL_DEFAULT);
+HttpResponse GeodeInstaller::perform_http_request(const std::string& url, const std::vector<std::string>& headers) const {
+    return http_client_.get({url, headers});
 }
 
 std::string GeodeInstaller::make_http_request(const std::string& url) const {
-    CURL* curl;
-    CURLcode res;
-    std::string response;
+    HttpResponse response = perform_http_request(url);
     
-    curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("Failed to initialize curl");
+    if (response.status_code != 200) {
+        throw std::runtime_error("HTTP error code: " + std::to_string(response.status_code));
     }
     
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    
-    res = curl_easy_perform(curl);
-    
-    long response_code;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-    
-    curl_easy_cleanup(curl);
+    return response.body;
+}
+
+std::string GeodeInstaller::download_file(const std::vector<std::string>& urls, const fs::path& output_path) const {
+    SegmentedDownloader downloader(http_client_, options_.download_segments);
+    return downloader.download(urls, output_path);
+}
+
+std::optional<std::string> GeodeInstaller::fetch_release_digest(const std::string& tag) const {
+    TraceSpan span("fetch_release_digest", "api");
+    
+    std::string url = options_.github_api_base_url + "/releases/tags/" + tag;
+    std::string asset_name = "geode-" + tag + "-win.zip";
+    
+    HttpResponse response;
+    try {
+        response = perform_http_request(url, {
+            "Accept: application/vnd.github+json",
+            "User-Agent: geode-installer-linux",
+        });
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
     
-    if (res != CURLE_OK) {
-        throw std::runtime_error("Curl request failed: " + std::string(curl_easy_strerror(res)));
+    Json::Value root;
+    Json::Reader reader;
+    if (response.status_code != 200 || !reader.parse(response.body, root) || !root["assets"].isArray()) {
+        return std::nullopt;
     }
     
-    if (response_code != 200) {
-        throw std::runtime_error("HTTP error code: " + std::to_string(response_code));
+    for (const auto& asset : root["assets"]) {
+        std::string digest = asset["digest"].asString();
+        
+        if (asset["name"].asString() == asset_name && digest.rfind("sha256:", 0) == 0) {
+            digest = digest.substr(7);
+            std::transform(digest.begin(), digest.end(), digest.begin(), [](unsigned char c) { return std::tolower(c); });
+            return digest;
+        }
     }
     
-    return response;
+    return std::nullopt;
+}
+
+std::future<std::optional<std::string>> GeodeInstaller::request_release_digest() const {
+    // looked up next to the download, so it never adds to the install time
+    std::string tag = get_latest_geode_tag();
+    return std::async(std::launch::async, [this, tag]() { return fetch_release_digest(tag); });
 }
 
-void GeodeInstaller::download_file(const std::string& url, const fs::path& output_path) const {
-    CURL* curl;
-    CURLcode res;
-    FILE* file;
+void GeodeInstaller::verify_release_digest(std::future<std::optional<std::string>>& expected, const std::string& actual) const {
+    std::optional<std::string> digest = expected.get();
     
-    file = fopen(output_path.string().c_str(), "wb");
-    if (!file) {
-        throw std::runtime_error("Failed to open file for writing: " + output_path.string());
+    if (!digest) {
+        std::cout << "No published checksum found for this release, skipping verification" << std::endl;
+        return;
     }
     
-    curl = curl_easy_init();
-    if (!curl) {
-        fclose(file);
-        throw std::runtime_error("Failed to initialize curl");
+    if (*digest != actual) {
+        throw std::runtime_error("Checksum mismatch: expected sha256 " + *digest + ", got " + actual);
+    }
+}
+
+// inside the destination, so committing the entries is a rename on the same filesystem
+static fs::path create_staging_dir(const fs::path& destination_dir) {
+    static std::atomic<size_t> counter{0};
+    
+    fs::path staging = destination_dir / (".geode-installer-staging." + std::to_string(getpid()) + "." +
+                                          std::to_string(counter++));
+    fs::remove_all(staging);
+    fs::create_directories(staging);
+    return staging;
+}
+
+std::vector<std::string> GeodeInstaller::download_and_extract(const std::vector<std::string>& urls, const std::shared_future<fs::path>& destination) const {
+    TraceSpan span("stream_extract", "extract");
+    
+    std::future<std::optional<std::string>> expected_digest = request_release_digest();
+    
+    std::optional<ZipStreamExtractor> extractor;
+    // entries land here until the archive's digest has been checked
+    fs::path staging_dir;
+    Sha256Pipeline hasher;
+    uint64_t received = 0;
+    // ends with the transfer, extraction runs on as its own phase
+    std::optional<ProgressPhase> progress;
+    progress.emplace("download");
+    
+    // data that arrives before the destination is known is held in memory
+    std::string pending;
+    
+    auto start_extractor = [&](bool wait) {
+        if (extractor) {
+            return true;
+        }
+        
+        if (!wait && destination.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+        
+        fs::path destination_dir = destination.get();
+        staging_dir = create_staging_dir(destination_dir);
+        
+        extractor.emplace(destination_dir, staging_dir);
+        extractor->set_skip_unchanged(options_.incremental);
+        extractor->feed(pending.data(), pending.size());
+        span.set_arg("buffered_bytes", static_cast<double>(pending.size()));
+        
+        pending.clear();
+        pending.shrink_to_fit();
+        return true;
+    };
+    
+    // errors from the extractor or the destination end the install, only
+    // transfer errors move on to the next mirror
+    bool consumer_failed = false;
+    auto on_data = [&](const char* data, size_t size) {
+        try {
+            hasher.update(data, size);
+            
+            if (start_extractor(false)) {
+                extractor->feed(data, size);
+            } else {
+                pending.append(data, size);
+            }
+        } catch (...) {
+            consumer_failed = true;
+            throw;
+        }
+        received += size;
+    };
+    
+    try {
+        // a mirror that stalls or drops the connection is left for the next one,
+        // which continues from the first byte the extractor hasn't seen
+        HttpResponse response;
+        for (size_t attempt = 0;; attempt++) {
+            HttpRequest request{urls[attempt], {}, 300};
+            request.progress = &*progress;
+            if (urls.size() > 1) {
+                request.stall_timeout = kMirrorStallTimeout;
+            }
+            if (received > 0) {
+                request.headers.push_back("Range: bytes=" + std::to_string(received) + "-");
+                request.expected_status = 206;
+            }
+            
+            std::string error;
+            try {
+                uint64_t before = received;
+                response = http_client_.stream(request, on_data);
+                
+                if (response.status_code == (before > 0 ? 206 : 200)) {
+                    break;
+                }
+                error = "HTTP error code: " + std::to_string(response.status_code);
+            } catch (const std::exception& e) {
+                if (consumer_failed) {
+                    throw;
+                }
+                error = e.what();
+            }
+            
+            if (attempt + 1 >= urls.size()) {
+                throw std::runtime_error(error);
+            }
+            
+            std::cout << "Download from " << request.url << " failed (" << error << "), switching to "
+                      << urls[attempt + 1] << std::endl;
+            span.set_arg("mirror_switches", static_cast<double>(attempt + 1));
+        }
+        
+        progress.reset();
+        span.set_arg("bytes", static_cast<double>(received));
+        
+        start_extractor(true);
+        extractor->finish();
+        
+        // nothing reaches the destination before the digest matches
+        verify_release_digest(expected_digest, hasher.finish());
+        extractor->commit();
+    } catch (...) {
+        // the writer's threads have to be done with the staged files first
+        extractor.reset();
+        if (!staging_dir.empty()) {
+            std::error_code ec;
+            fs::remove_all(staging_dir, ec);
+        }
+        throw;
     }
     
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteFileCallback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, file);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300L);
-    
-    res = curl_easy_perform(curl);
-    
-    long response_code;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-    
-    curl_easy_cleanup(curl);
-    fclose(file);
+    span.set_arg("files", static_cast<double>(extractor->get_extracted_count()));
+    span.set_arg("unchanged", static_cast<double>(extractor->get_skipped_count()));
     
-    if (res != CURLE_OK) {
-        fs::remove(output_path);
-        throw std::runtime_error("Download failed: " + std::string(curl_easy_strerror(res)));
+    if (options_.incremental) {
+        std::cout << extractor->get_extracted_count() << " files updated, "
+                  << extractor->get_skipped_count() << " unchanged" << std::endl;
     }
     
-    if (response_code != 200) {
-        fs::remove(output_path);
-        throw std::runtime_error("HTTP error code: " + std::to_string(response_code));
-    }
+    return extractor->get_file_names();
 }
 
-void GeodeInstaller::extract_zip(const fs::path& zip_path, const fs::path& destination) const {
+static zip_t* open_zip_archive(const fs::path& zip_path) {
     int err = 0;
-    zip_t* archive = zip_open(zip_path.string().c_str(), 0, &err);
+    zip_t* archive = zip_open(zip_path.string().c_str(), ZIP_RDONLY, &err);
     
     if (!archive) {
         zip_error_t error;
@@ -108,78 +267,201 @@ void GeodeInstaller::extract_zip(const fs::path& zip_path, const fs::path& desti
         throw std::runtime_error(error_msg);
     }
     
+    return archive;
+}
+
+struct ZipEntry {
+    zip_uint64_t index;
+    std::string name;
+    zip_uint64_t size;
+    zip_uint64_t compressed_size;
+    zip_uint32_t crc;
+};
+
+// the whole entry in memory, the writer gets it in one piece at its final size
+static std::vector<char> read_zip_entry(zip_t* archive, const ZipEntry& entry) {
+    zip_file_t* file = zip_fopen_index(archive, entry.index, 0);
+    if (!file) {
+        throw std::runtime_error("Failed to open file in zip: " + entry.name);
+    }
+    
+    std::vector<char> contents(entry.size);
+    zip_uint64_t total = 0;
+    zip_int64_t bytes_read = 0;
+    
+    while (total < entry.size && (bytes_read = zip_fread(file, contents.data() + total, entry.size - total)) > 0) {
+        total += bytes_read;
+    }
+    
+    zip_fclose(file);
+    
+    if (bytes_read < 0 || total != entry.size) {
+        throw std::runtime_error("Failed to read from zip file: " + entry.name);
+    }
+    
+    return contents;
+}
+
+std::vector<std::string> GeodeInstaller::extract_zip(const fs::path& zip_path, const fs::path& destination, size_t thread_count) const {
+    TraceSpan span("extract_zip", "extract");
+    
+    std::optional<ZipFileExtractor> extractor;
+    try {
+        extractor.emplace(zip_path);
+    } catch (const std::exception&) {
+        span.set_arg("backend", "libzip");
+        return extract_zip_with_libzip(zip_path, destination, thread_count);
+    }
+    
+    span.set_arg("backend", ZipFileExtractor::inflate_backend());
+    extractor->set_skip_unchanged(options_.incremental);
+    extractor->extract(destination, thread_count);
+    
+    if (options_.incremental) {
+        std::cout << extractor->get_extracted_count() << " files updated, "
+                  << extractor->get_skipped_count() << " unchanged" << std::endl;
+    }
+    
+    std::vector<std::string> files;
+    for (const auto& entry : extractor->get_entries()) {
+        files.push_back(entry.name);
+    }
+    return files;
+}
+
+std::vector<std::string> GeodeInstaller::extract_zip_with_libzip(const fs::path& zip_path, const fs::path& destination, size_t thread_count) const {
+    TraceSpan span("extract_zip_libzip", "extract");
+    
+    zip_t* archive = open_zip_archive(zip_path);
+    
     zip_int64_t num_entries = zip_get_num_entries(archive, 0);
     if (num_entries < 0) {
         zip_close(archive);
         throw std::runtime_error("Failed to get number of entries in zip file");
     }
     
+    // read the central directory once, workers only need indices
+    std::vector<ZipEntry> entries;
+    std::vector<std::string> directories;
+    
     for (zip_int64_t i = 0; i < num_entries; i++) {
-        const char* name = zip_get_name(archive, i, 0);
-        if (!name) {
+        zip_stat_t stat;
+        if (zip_stat_index(archive, i, 0, &stat) != 0 || !(stat.valid & ZIP_STAT_NAME)) {
             zip_close(archive);
             throw std::runtime_error("Failed to get entry name");
         }
         
-        fs::path entry_path = destination / name;
+        std::string name = stat.name;
         
-        if (name[strlen(name) - 1] == '/') {
-            fs::create_directories(entry_path);
-            continue;
+        if (!is_contained_entry_name(name)) {
+            zip_close(archive);
+            throw std::runtime_error("Zip entry points outside the destination: " + name);
         }
         
-        fs::create_directories(entry_path.parent_path());
-        
-        zip_file_t* file = zip_fopen_index(archive, i, 0);
-        if (!file) {
-            zip_close(archive);
-            throw std::runtime_error("Failed to open file in zip: " + std::string(name));
+        if (name.back() == '/') {
+            directories.push_back(name);
+            continue;
         }
         
-        std::ofstream output(entry_path, std::ios::binary);
-        if (!output) {
-            zip_fclose(file);
+        if (!(stat.valid & ZIP_STAT_SIZE) || !(stat.valid & ZIP_STAT_CRC)) {
             zip_close(archive);
-            throw std::runtime_error("Failed to create output file: " + entry_path.string());
+            throw std::runtime_error("Failed to stat zip entry: " + name);
         }
         
-        char buffer[8192];
-        zip_int64_t bytes_read;
-        while ((bytes_read = zip_fread(file, buffer, sizeof(buffer))) > 0) {
-            output.write(buffer, bytes_read);
-        }
+        entries.push_back({stat.index, name, stat.size, (stat.valid & ZIP_STAT_COMP_SIZE) ? stat.comp_size : 0, stat.crc});
+    }
+    
+    zip_close(archive);
+    
+    // parents of the files are created by the writer as it goes, only empty
+    // directories need to be made here
+    BatchedFileWriter writer(destination);
+    for (const auto& directory : directories) {
+        writer.create_directory(directory);
+    }
+    
+    // biggest entries first so the large DLLs don't end up as the tail
+    std::sort(entries.begin(), entries.end(), [](const ZipEntry& a, const ZipEntry& b) {
+        return a.compressed_size > b.compressed_size;
+    });
+    
+    // every worker gets its own handle, libzip archives aren't thread safe
+    thread_count = resolve_thread_count(thread_count, entries.size());
+    std::atomic<size_t> next_entry{0};
+    std::atomic<size_t> skipped{0};
+    
+    uint64_t total_size = 0;
+    for (const auto& entry : entries) {
+        total_size += entry.size;
+    }
+    ProgressPhase progress("extract", total_size, entries.size());
+    
+    if (span.active()) {
+        span.set_arg("entries", static_cast<double>(entries.size()));
+        span.set_arg("bytes", static_cast<double>(total_size));
+        span.set_arg("threads", static_cast<double>(thread_count));
+    }
+    
+    parallel_for(thread_count, thread_count, [&](size_t) {
+        TraceSpan worker_span("extract_worker", "extract");
+        size_t worker_entries = 0;
+        uint64_t worker_bytes = 0;
         
-        if (bytes_read < 0) {
-            zip_fclose(file);
-            zip_close(archive);
-            throw std::runtime_error("Failed to read from zip file");
+        zip_t* worker_archive = open_zip_archive(zip_path);
+        
+        try {
+            size_t i;
+            while ((i = next_entry.fetch_add(1)) < entries.size()) {
+                const ZipEntry& entry = entries[i];
+                
+                if (options_.incremental && file_matches_crc(destination / entry.name, entry.size, entry.crc)) {
+                    skipped++;
+                    progress.add_bytes(entry.size);
+                    progress.add_items();
+                    continue;
+                }
+                
+                writer.submit(entry.name, read_zip_entry(worker_archive, entry));
+                worker_entries++;
+                worker_bytes += entry.size;
+                progress.add_bytes(entry.size);
+                progress.add_items();
+            }
+        } catch (...) {
+            next_entry = entries.size();
+            zip_close(worker_archive);
+            throw;
         }
         
-        output.close();
-        zip_fclose(file);
+        zip_close(worker_archive);
+        
+        worker_span.set_arg("entries", static_cast<double>(worker_entries));
+        worker_span.set_arg("bytes", static_cast<double>(worker_bytes));
+    });
+    
+    writer.finish();
+    
+    span.set_arg("unchanged", static_cast<double>(skipped.load()));
+    span.set_arg("io_uring", writer.uses_io_uring() ? 1.0 : 0.0);
+    
+    if (options_.incremental) {
+        std::cout << entries.size() - skipped << " files updated, " << skipped << " unchanged" << std::endl;
     }
     
-    zip_close(archive);
-}
-
-std::string GeodeInstaller::get_current_timestamp() const {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    return std::to_string(time_t);
+    std::vector<std::string> files;
+    for (const auto& entry : entries) {
+        files.push_back(entry.name);
+    }
+    return files;
 }
 
-std::string GeodeInstaller::get_hex_timestamp() const {
-    auto now = std::chrono::system_clock::now();
-    auto time_t = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::hex << time_t;
-    return ss.str();
+static std::vector<std::string> with_mirrors(const std::string& primary, const std::vector<std::string>& mirrors) {
+    std::vector<std::string> base_urls{primary};
+    base_urls.insert(base_urls.end(), mirrors.begin(), mirrors.end());
+    return base_urls;
 }
 
-std::string GeodeInstaller::get_latest_geode_tag() const {
-    std::string url = "https://api.geode-sdk.org/v1/loader/versions/latest";
-    std::string response = make_http_request(url);
-    
+static std::string parse_latest_geode_tag(const std::string& response) {
     Json::Value root;
     Json::Reader reader;
     
@@ -198,76 +480,296 @@ std::string GeodeInstaller::get_latest_geode_tag() const {
     return root["payload"]["tag"].asString();
 }
 
+std::string GeodeInstaller::get_latest_geode_tag() const {
+    // resolved once per run, every install after the first reuses it
+    std::lock_guard<std::mutex> lock(tag_mutex_);
+    
+    if (!latest_tag_) {
+        latest_tag_ = fetch_latest_geode_tag();
+    }
+    
+    return *latest_tag_;
+}
+
+std::string GeodeInstaller::fetch_latest_geode_tag() const {
+    TraceSpan span("fetch_release_tag", "api");
+    
+    ReleaseCache cache(get_cache_dir() / "latest-loader.json");
+    std::optional<CachedRelease> cached = cache.load();
+    if (cached && cached->api_url != options_.api_base_url) {
+        cached.reset();
+    }
+    
+    int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    
+    if (options_.offline) {
+        if (!cached) {
+            throw std::runtime_error("Offline mode requested but no Geode release is cached");
+        }
+        span.set_arg("source", "offline cache");
+        return cached->tag;
+    }
+    
+    if (cached && now - cached->fetched_at >= 0 && now - cached->fetched_at < options_.metadata_ttl.count()) {
+        span.set_arg("source", "cache");
+        return cached->tag;
+    }
+    
+    std::vector<std::string> headers;
+    if (cached && !cached->etag.empty()) {
+        headers.push_back("If-None-Match: " + cached->etag);
+    }
+    if (cached && !cached->last_modified.empty()) {
+        headers.push_back("If-Modified-Since: " + cached->last_modified);
+    }
+    
+    // the first mirror with an answer wins, a 304 is as good as a 200
+    HttpResponse response;
+    try {
+        response = MirrorSelector(http_client_).race(with_mirrors(options_.api_base_url, options_.api_mirrors),
+                                                     "/v1/loader/versions/latest", headers,
+                                                     [](const HttpResponse& candidate) {
+            return candidate.status_code == 200 || candidate.status_code == 304;
+        });
+    } catch (const std::exception& e) {
+        if (!cached) {
+            throw;
+        }
+        std::cout << "Can't reach the Geode API (" << e.what() << "), using cached tag " << cached->tag << std::endl;
+        span.set_arg("source", "stale cache");
+        return cached->tag;
+    }
+    
+    if (response.status_code == 304 && cached) {
+        cached->fetched_at = now;
+        cache.store(*cached);
+        span.set_arg("source", "not modified");
+        return cached->tag;
+    }
+    
+    if (response.status_code != 200) {
+        throw std::runtime_error("HTTP error code: " + std::to_string(response.status_code));
+    }
+    
+    CachedRelease release;
+    release.api_url = options_.api_base_url;
+    release.tag = parse_latest_geode_tag(response.body);
+    release.etag = response.headers["etag"];
+    release.last_modified = response.headers["last-modified"];
+    release.fetched_at = now;
+    cache.store(release);
+    
+    span.set_arg("source", "network");
+    return release.tag;
+}
+
 std::string GeodeInstaller::get_download_url() const {
     std::string tag = get_latest_geode_tag();
-    return "https://github.com/geode-sdk/geode/releases/download/" + tag + "/geode-" + tag + "-win.zip";
+    return options_.release_base_url + "/" + tag + "/geode-" + tag + "-win.zip";
 }
 
-void GeodeInstaller::unzip_to_destination(const std::string& zip_url, const fs::path& destination_dir) const {
-    fs::path zip_file_path = destination_dir / "geode_win.zip";
-    fs::create_directories(destination_dir);
-
-    std::cout << "Downloading geode_win.zip from " << zip_url << "...\n";
+std::vector<std::string> GeodeInstaller::get_download_urls() const {
+    std::string tag = get_latest_geode_tag();
+    std::string path = "/" + tag + "/geode-" + tag + "-win.zip";
+    
+    std::vector<MirrorProbe> probes = MirrorSelector(http_client_).rank(
+        with_mirrors(options_.release_base_url, options_.release_mirrors), path);
     
-    download_file(zip_url, zip_file_path);
-    extract_zip(zip_file_path, destination_dir);
-    fs::remove(zip_file_path);
+    std::vector<std::string> urls;
+    for (const auto& probe : probes) {
+        if (probe.reachable) {
+            urls.push_back(probe.base_url + path);
+        }
+    }
+    
+    // nothing answered the probe, let the download report why
+    if (urls.empty()) {
+        urls.push_back(get_download_url());
+    }
+    
+    if (probes.size() > 1 && probes.front().reachable) {
+        std::cout << "Fastest mirror: " << probes.front().base_url << " ("
+                  << static_cast<int>(probes.front().throughput / 1024) << " KiB/s)" << std::endl;
+    }
+    
+    return urls;
 }
 
-void GeodeInstaller::install_to_dir(const fs::path& destination_dir) const {
-    std::string win_zip_release_link = get_download_url();
+std::vector<std::string> GeodeInstaller::install_to_dir(const fs::path& destination_dir) const {
+    return install_to_deferred_dir(ready_path(destination_dir));
+}
 
+std::vector<std::string> GeodeInstaller::install_to_deferred_dir(const std::shared_future<fs::path>& destination_dir) const {
+    if (options_.use_store) {
+        ReleaseStore store = open_store();
+        std::string tag = add_release_to_store(store);
+        
+        MaterializeStats stats = store.materialize(tag, destination_dir.get(), options_.extract_threads);
+        std::cout << "Installed from the store: " << stats.reflinked << " reflinked, " << stats.hardlinked
+                  << " hardlinked, " << stats.copied << " copied, " << stats.unchanged << " unchanged" << std::endl;
+        return stats.files;
+    }
+    
     std::cout << "Get ready to download Geode...\n";
+    
+    // an existing install only needs what changed, anything going wrong on
+    // the way is left to a full download
+    if (options_.partial_update && !options_.offline && is_loader_present(destination_dir.get())) {
+        std::vector<std::string> urls = get_download_urls();
+        try {
+            return update_changed_entries(urls.front(), destination_dir.get());
+        } catch (const std::exception& e) {
+            std::cout << "Partial update failed (" << e.what() << "), downloading the whole release...\n";
+        }
+    }
+
+    if (options_.stream_extract) {
+        std::vector<std::string> urls = get_download_urls();
+        std::cout << "Streaming geode_win.zip from " << urls.front() << "...\n";
+        return download_and_extract(urls, destination_dir);
+    }
 
-    unzip_to_destination(win_zip_release_link, destination_dir);
+    // the archive has to land somewhere before the destination is known,
+    // the release cache also lets the next install skip the download
+    fs::path zip_path = download_release_archive();
+    return extract_zip(zip_path, destination_dir.get(), options_.extract_threads);
 }
 
-void GeodeInstaller::patch_prefix_registry(const fs::path& reg_file_path) const {
-    if (!fs::exists(reg_file_path)) {
-        throw std::runtime_error("Registry file not found: " + reg_file_path.string());
+std::vector<std::string> GeodeInstaller::update_changed_entries(const std::string& url, const fs::path& destination) const {
+    TraceSpan span("partial_update", "install");
+    
+    std::cout << "Checking " << url << " for changed files...\n";
+    RemoteZip zip(http_client_, url);
+    const std::vector<RemoteZipEntry>& entries = zip.get_entries();
+    
+    std::vector<char> changed_flags(entries.size());
+    parallel_for(entries.size(), options_.extract_threads, [&](size_t i) {
+        const RemoteZipEntry& entry = entries[i];
+        if (!entry.name.empty() && entry.name.back() == '/') {
+            changed_flags[i] = !fs::is_directory(destination / entry.name);
+        } else {
+            changed_flags[i] = !file_matches_crc(destination / entry.name, entry.uncompressed_size, entry.crc);
+        }
+    });
+    
+    std::vector<const RemoteZipEntry*> changed;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (changed_flags[i]) {
+            changed.push_back(&entries[i]);
+        }
     }
     
-    std::ifstream file(reg_file_path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open registry file: " + reg_file_path.string());
+    span.set_arg("entries", static_cast<double>(entries.size()));
+    span.set_arg("changed", static_cast<double>(changed.size()));
+    
+    if (!changed.empty()) {
+        // entries fetched along with a changed neighbour are skipped again here
+        ZipStreamExtractor extractor(destination);
+        extractor.set_skip_unchanged(true);
+        zip.fetch_entries(changed, [&](const char* data, size_t size) { extractor.feed(data, size); });
+        extractor.finish();
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string content = buffer.str();
-    file.close();
+    span.set_arg("bytes", static_cast<double>(zip.get_fetched_bytes()));
+    std::cout << changed.size() << " of " << entries.size() << " files changed, downloaded "
+              << zip.get_fetched_bytes() / 1024 << " KiB of " << zip.get_size() / 1024 << " KiB" << std::endl;
+    
+    std::vector<std::string> files;
+    for (const auto& entry : entries) {
+        if (!entry.name.empty() && entry.name.back() != '/') {
+            files.push_back(entry.name);
+        }
+    }
+    return files;
+}
+
+static constexpr const char* kDllOverridesSection = "Software\\\\Wine\\\\DllOverrides";
+static constexpr const char* kXinputOverride = "xinput1_4";
+static constexpr const char* kXinputOverrideValue = "native,builtin";
+
+// the xinput proxy Wine is told to load and the loader it pulls in
+static constexpr const char* kLoaderFiles[] = {"XInput1_4.dll", "Geode.dll"};
+
+bool GeodeInstaller::patch_prefix_registry(const fs::path& reg_file_path) const {
+    TraceSpan span("patch_registry", "registry");
+    if (span.active()) {
+        std::error_code ec;
+        uintmax_t size = fs::file_size(reg_file_path, ec);
+        if (!ec) {
+            span.set_arg("bytes", static_cast<double>(size));
+        }
+    }
     
-    const std::string dll_overrides_section = "[Software\\\\Wine\\\\DllOverrides]";
-    const std::string xinput_entry = "\"xinput1_4\"=\"native,builtin\"";
+    WineRegistry registry(reg_file_path);
+    bool added = !registry.get_value(kDllOverridesSection, kXinputOverride).has_value();
     
-    if (content.find(dll_overrides_section) == std::string::npos) {
-        // section doesn't exist, add it
-        content += "\n\n" + dll_overrides_section + " " + get_current_timestamp() + "\n";
-        content += "#time=" + get_hex_timestamp() + "\n";
-        content += xinput_entry + "\n";
-    } else {
-        if (content.find("\"xinput1_4\"=") == std::string::npos) {
-            size_t section_pos = content.find(dll_overrides_section);
-            size_t next_section_pos = content.find("\n[", section_pos + dll_overrides_section.length());
-            
-            if (next_section_pos != std::string::npos) {
-                content.insert(next_section_pos, xinput_entry + "\n");
-            } else {
-                content += "\n" + xinput_entry + "\n";
-            }
+    registry.apply({
+        {kDllOverridesSection, kXinputOverride, kXinputOverrideValue, RegistryEdit::Action::SetIfMissing},
+    });
+    return added;
+}
+
+bool GeodeInstaller::is_prefix_patched(const fs::path& reg_file_path) const {
+    // any value counts, like SetIfMissing above a user's own choice is kept
+    return WineRegistry(reg_file_path).get_value(kDllOverridesSection, kXinputOverride).has_value();
+}
+
+void GeodeInstaller::write_install_manifest(const fs::path& gd_path, const std::vector<std::string>& files,
+                                            const fs::path& reg_file_path, bool override_added) const {
+    InstallManifest manifest = InstallManifest::record(gd_path, files, options_.extract_threads);
+    manifest.tag = get_latest_geode_tag();
+    manifest.registry_file = reg_file_path;
+    
+    // an override an earlier install added is still ours to revert, with no
+    // prefix at hand the recorded one is kept as it is
+    try {
+        std::optional<InstallManifest> previous = InstallManifest::load(gd_path);
+        if (previous && (reg_file_path.empty() || previous->registry_file == reg_file_path)) {
+            manifest.registry_file = previous->registry_file;
+            manifest.registry_edits = previous->registry_edits;
         }
+    } catch (const std::exception&) {
+        // a damaged manifest is simply replaced
     }
     
-    std::ofstream out_file(reg_file_path);
-    if (!out_file.is_open()) {
-        throw std::runtime_error("Failed to write to registry file: " + reg_file_path.string());
+    bool recorded = std::any_of(manifest.registry_edits.begin(), manifest.registry_edits.end(),
+                                [](const RegistryEdit& edit) { return edit.name == kXinputOverride; });
+    if (override_added && !recorded) {
+        manifest.registry_edits.push_back({kDllOverridesSection, kXinputOverride, kXinputOverrideValue});
     }
     
-    out_file << content;
-    out_file.close();
+    manifest.save(gd_path);
+}
+
+VerifyResult GeodeInstaller::verify_install(const fs::path& gd_path) const {
+    std::optional<InstallManifest> manifest = InstallManifest::load(gd_path);
+    if (!manifest) {
+        throw std::runtime_error("No install manifest in " + gd_path.string());
+    }
+    return manifest->verify(gd_path, options_.extract_threads);
+}
+
+UninstallResult GeodeInstaller::uninstall(const fs::path& gd_path) const {
+    std::optional<InstallManifest> manifest = InstallManifest::load(gd_path);
+    if (!manifest) {
+        throw std::runtime_error("No install manifest in " + gd_path.string());
+    }
+    return manifest->uninstall(gd_path);
+}
+
+bool GeodeInstaller::is_loader_present(const fs::path& gd_path) const {
+    for (const char* file : kLoaderFiles) {
+        if (!fs::is_regular_file(gd_path / file)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void GeodeInstaller::install_geode_to_wine(const fs::path& prefix, const fs::path& gd_path) const {
+    TraceSpan span("install_to_wine", "install");
+    
     if (!fs::exists(prefix)) {
         throw std::runtime_error("Can't find prefix: " + prefix.string());
     }
@@ -277,24 +779,27 @@ void GeodeInstaller::install_geode_to_wine(const fs::path& prefix, const fs::pat
     }
     
     std::cout << "Installing Geode to: " << gd_path.string() << std::endl;
-    install_to_dir(gd_path);
+    std::vector<std::string> files = install_to_dir(gd_path);
     
     std::cout << "Patching Wine registry..." << std::endl;
     fs::path user_reg = prefix / "user.reg";
-    patch_prefix_registry(user_reg);
+    bool override_added = patch_prefix_registry(user_reg);
+    write_install_manifest(gd_path, files, user_reg, override_added);
     
     std::cout << "Geode installation completed!" << std::endl;
 }
 
-void GeodeInstaller::install_geode_to_steam() const {
-    if (!finder_.get_steam_root()) {
+GameInfo GeodeInstaller::find_steam_game() const {
+    const SteamGameFinder& finder = get_finder();
+    
+    if (!finder.get_steam_root()) {
         throw std::runtime_error("Can't find Steam Root");
     }
     
-    std::cout << "Steam root found at: " << finder_.get_steam_root()->string() << std::endl;
+    std::cout << "Steam root found at: " << finder.get_steam_root()->string() << std::endl;
     
     // gd appid is 322170
-    GameInfo gd_info = finder_.get_game_info("322170");
+    GameInfo gd_info = finder.get_game_info("322170");
     
     if (!gd_info.found) {
         throw std::runtime_error("Can't find Geometry Dash.");
@@ -312,5 +817,197 @@ void GeodeInstaller::install_geode_to_steam() const {
         throw std::runtime_error("Can't find Steam GD at " + gd_info.game_path->string());
     }
     
-    install_geode_to_wine(*gd_info.proton_prefix, *gd_info.game_path);
-}
\ No newline at end of file
+    return gd_info;
+}
+
+void GeodeInstaller::install_geode_to_steam() const {
+    TraceSpan span("install_to_steam", "install");
+    
+    // the tag lookup and the download don't need anything from Steam until
+    // extraction starts, so they run while the libraries are scanned here
+    std::promise<fs::path> gd_path_promise;
+    std::shared_future<fs::path> gd_path = gd_path_promise.get_future().share();
+    
+    std::future<std::vector<std::string>> install = std::async(std::launch::async, [this, gd_path]() {
+        return install_to_deferred_dir(gd_path);
+    });
+    
+    GameInfo gd_info;
+    try {
+        gd_info = find_steam_game();
+    } catch (...) {
+        // a streamed download stops at its next chunk once it sees this
+        gd_path_promise.set_exception(std::current_exception());
+        try {
+            install.get();
+        } catch (...) {
+        }
+        throw;
+    }
+    
+    std::cout << "Installing Geode to: " << gd_info.game_path->string() << std::endl;
+    gd_path_promise.set_value(*gd_info.game_path);
+    std::vector<std::string> files = install.get();
+    
+    std::cout << "Patching Wine registry..." << std::endl;
+    fs::path user_reg = *gd_info.proton_prefix / "user.reg";
+    bool override_added = patch_prefix_registry(user_reg);
+    write_install_manifest(*gd_info.game_path, files, user_reg, override_added);
+    
+    std::cout << "Geode installation completed!" << std::endl;
+}
+
+ReleaseStore GeodeInstaller::open_store() const {
+    fs::path root = options_.store_dir.empty() ? get_cache_dir() / "store" : fs::path(options_.store_dir);
+    return ReleaseStore(root, options_.store_hardlinks);
+}
+
+std::string GeodeInstaller::add_release_to_store(const ReleaseStore& store) const {
+    TraceSpan span("store_release", "store");
+    
+    std::string tag = get_latest_geode_tag();
+    span.set_arg("tag", tag);
+    
+    if (store.has_release(tag)) {
+        span.set_arg("cached", 1);
+        return tag;
+    }
+    
+    // extracted next to the objects, so adding it is a rename per file
+    fs::path staging_dir = store.create_staging_dir(tag);
+    
+    try {
+        if (options_.stream_extract) {
+            std::cout << "Streaming geode_win.zip into the store..." << std::endl;
+            download_and_extract(get_download_urls(), ready_path(staging_dir));
+        } else {
+            extract_zip(download_release_archive(), staging_dir, options_.extract_threads);
+        }
+        
+        store.add_release(tag, staging_dir, options_.extract_threads);
+    } catch (...) {
+        std::error_code ec;
+        fs::remove_all(staging_dir, ec);
+        throw;
+    }
+    
+    return tag;
+}
+
+fs::path GeodeInstaller::download_release_archive() const {
+    TraceSpan span("release_archive", "download");
+    
+    std::string tag = get_latest_geode_tag();
+    fs::path cache_dir = get_cache_dir();
+    fs::path zip_path = cache_dir / ("geode-" + tag + "-win.zip");
+    
+    fs::create_directories(cache_dir);
+    
+    // a complete archive from an earlier run is reused
+    if (fs::exists(zip_path)) {
+        int err = 0;
+        zip_t* archive = zip_open(zip_path.string().c_str(), ZIP_RDONLY | ZIP_CHECKCONS, &err);
+        if (archive) {
+            zip_close(archive);
+            span.set_arg("cached", 1);
+            return zip_path;
+        }
+        fs::remove(zip_path);
+    }
+    
+    if (options_.offline) {
+        throw std::runtime_error("Offline mode requested but " + zip_path.string() + " is not cached");
+    }
+    
+    fs::path part_path = zip_path;
+    part_path += ".part";
+    
+    std::cout << "Downloading " << zip_path.filename().string() << "..." << std::endl;
+    std::future<std::optional<std::string>> expected_digest = request_release_digest();
+    std::string digest = download_file(get_download_urls(), part_path);
+    
+    try {
+        verify_release_digest(expected_digest, digest);
+    } catch (...) {
+        fs::remove(part_path);
+        throw;
+    }
+    
+    int err = 0;
+    zip_t* archive = zip_open(part_path.string().c_str(), ZIP_RDONLY | ZIP_CHECKCONS, &err);
+    if (!archive) {
+        fs::remove(part_path);
+        throw std::runtime_error("Downloaded release archive is not a valid zip file");
+    }
+    zip_close(archive);
+    
+    fs::rename(part_path, zip_path);
+    return zip_path;
+}
+
+std::vector<InstallResult> GeodeInstaller::install_geode_batch(const std::vector<InstallTarget>& targets) const {
+    std::vector<InstallResult> results(targets.size());
+    
+    if (targets.empty()) {
+        return results;
+    }
+    
+    // the release is extracted once, either into the store or as the cached zip
+    std::optional<ReleaseStore> store;
+    std::string store_tag;
+    fs::path zip_path;
+    
+    if (options_.use_store) {
+        store.emplace(open_store());
+        store_tag = add_release_to_store(*store);
+    } else {
+        zip_path = download_release_archive();
+    }
+    
+    // split the cores between concurrent installs instead of letting every
+    // extraction spawn a full pool
+    size_t jobs = resolve_thread_count(options_.batch_jobs, targets.size());
+    size_t extract_threads = options_.extract_threads;
+    if (extract_threads == 0) {
+        extract_threads = std::max<size_t>(1, resolve_thread_count(0, SIZE_MAX) / jobs);
+    }
+    
+    parallel_for(targets.size(), jobs, [&](size_t i) {
+        const InstallTarget& target = targets[i];
+        InstallResult& result = results[i];
+        result.target = target;
+        
+        TraceSpan span("install_target", "install");
+        span.set_arg("gd_path", target.gd_path.string());
+        
+        auto start = std::chrono::steady_clock::now();
+        
+        try {
+            if (!fs::exists(target.prefix)) {
+                throw std::runtime_error("Can't find prefix: " + target.prefix.string());
+            }
+            
+            if (!fs::exists(target.gd_path)) {
+                throw std::runtime_error("Can't find Geometry Dash: " + target.gd_path.string());
+            }
+            
+            std::vector<std::string> files;
+            if (store) {
+                files = store->materialize(store_tag, target.gd_path, extract_threads).files;
+            } else {
+                files = extract_zip(zip_path, target.gd_path, extract_threads);
+            }
+            fs::path user_reg = target.prefix / "user.reg";
+            bool override_added = patch_prefix_registry(user_reg);
+            write_install_manifest(target.gd_path, files, user_reg, override_added);
+            result.success = true;
+        } catch (const std::exception& e) {
+            result.error = e.what();
+        }
+        
+        result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+    });
+    
+    return results;
+}
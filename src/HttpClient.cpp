@@ -0,0 +1,258 @@
+#include "HttpClient.hpp"
+#include "Trace.hpp"
+#include "Progress.hpp"
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <stdexcept>
+
+struct TransferContext {
+    CURL* handle;
+    const HttpDataCallback* on_data;
+    HttpResponse* response;
+    long expected_status;
+    std::exception_ptr error;
+    const std::atomic<bool>* cancel = nullptr;
+    ProgressPhase* progress = nullptr;
+    // the phase's byte count when the transfer started, and how much of this
+    // transfer has been added to it since
+    uint64_t progress_base = 0;
+    curl_off_t progress_reported = 0;
+};
+
+static size_t WriteCallback(char* contents, size_t size, size_t nmemb, TransferContext* context) {
+    size_t length = size * nmemb;
+
+    if (!context->on_data) {
+        context->response->body.append(contents, length);
+        return length;
+    }
+
+    long response_code = 0;
+    curl_easy_getinfo(context->handle, CURLINFO_RESPONSE_CODE, &response_code);
+
+    // error pages are kept for the caller instead of being streamed
+    if (response_code < 200 || response_code >= 300) {
+        context->response->body.append(contents, length);
+        return length;
+    }
+
+    if (context->expected_status != 0 && response_code != context->expected_status) {
+        context->error = std::make_exception_ptr(
+            std::runtime_error("Unexpected HTTP status " + std::to_string(response_code)));
+        return 0;
+    }
+
+    try {
+        (*context->on_data)(contents, length);
+    } catch (...) {
+        context->error = std::current_exception();
+        return 0;
+    }
+
+    return length;
+}
+
+static int TransferInfoCallback(TransferContext* context, curl_off_t download_total, curl_off_t download_now,
+                                curl_off_t, curl_off_t) {
+    if (context->progress && download_now > context->progress_reported) {
+        context->progress->add_bytes(download_now - context->progress_reported);
+        context->progress_reported = download_now;
+
+        if (download_total > 0) {
+            context->progress->set_total_if_unknown(context->progress_base + download_total);
+        }
+    }
+
+    return context->cancel && context->cancel->load() ? 1 : 0;
+}
+
+static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, std::map<std::string, std::string>* headers) {
+    std::string line(buffer, size * nitems);
+    size_t colon = line.find(':');
+
+    if (colon != std::string::npos) {
+        std::string name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        size_t value_start = line.find_first_not_of(" \t", colon + 1);
+        size_t value_end = line.find_last_not_of(" \t\r\n");
+        (*headers)[name] = value_start == std::string::npos || value_end < value_start
+            ? ""
+            : line.substr(value_start, value_end - value_start + 1);
+    } else if (line.rfind("HTTP/", 0) == 0) {
+        // a new response after a redirect, drop the previous headers
+        headers->clear();
+    }
+
+    return size * nitems;
+}
+
+HttpClient::HttpClient() {
+    static std::once_flag curl_initialized;
+    std::call_once(curl_initialized, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+    share_ = curl_share_init();
+    if (!share_) {
+        throw std::runtime_error("Failed to initialize curl share");
+    }
+
+    // connections themselves stay with their pooled handle, curl can't
+    // share a connection cache between concurrent threads
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, lock_share);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC, unlock_share);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+}
+
+HttpClient::~HttpClient() {
+    for (CURL* handle : idle_handles_) {
+        curl_easy_cleanup(handle);
+    }
+    curl_share_cleanup(share_);
+}
+
+void HttpClient::lock_share(CURL*, curl_lock_data data, curl_lock_access, void* userptr) {
+    static_cast<HttpClient*>(userptr)->share_mutexes_[data].lock();
+}
+
+void HttpClient::unlock_share(CURL*, curl_lock_data data, void* userptr) {
+    static_cast<HttpClient*>(userptr)->share_mutexes_[data].unlock();
+}
+
+CURL* HttpClient::acquire_handle() {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!idle_handles_.empty()) {
+            CURL* handle = idle_handles_.back();
+            idle_handles_.pop_back();
+            return handle;
+        }
+    }
+
+    CURL* handle = curl_easy_init();
+    if (!handle) {
+        throw std::runtime_error("Failed to initialize curl");
+    }
+    return handle;
+}
+
+void HttpClient::release_handle(CURL* handle) {
+    // reset keeps the handle's open connections for the next request
+    curl_easy_reset(handle);
+
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    idle_handles_.push_back(handle);
+}
+
+HttpResponse HttpClient::get(const HttpRequest& request) {
+    return perform(request, nullptr);
+}
+
+HttpResponse HttpClient::stream(const HttpRequest& request, const HttpDataCallback& on_data) {
+    return perform(request, &on_data);
+}
+
+// curl's phase timestamps are cumulative from the start of the transfer
+static void add_timing_args(CURL* curl, TraceSpan& span) {
+    curl_off_t value = 0;
+
+    if (curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &value) == CURLE_OK) {
+        span.set_arg("dns_ms", value / 1000.0);
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &value) == CURLE_OK) {
+        span.set_arg("connect_ms", value / 1000.0);
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &value) == CURLE_OK) {
+        span.set_arg("tls_ms", value / 1000.0);
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &value) == CURLE_OK) {
+        span.set_arg("first_byte_ms", value / 1000.0);
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &value) == CURLE_OK) {
+        span.set_arg("total_ms", value / 1000.0);
+    }
+    if (curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &value) == CURLE_OK) {
+        span.set_arg("bytes", static_cast<double>(value));
+    }
+
+    long http_version = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &http_version) == CURLE_OK) {
+        span.set_arg("http_version", http_version == CURL_HTTP_VERSION_2_0 ? "2" : "1.1");
+    }
+}
+
+HttpResponse HttpClient::perform(const HttpRequest& request, const HttpDataCallback* on_data) {
+    TraceSpan span("http_request", "http");
+    span.set_arg("url", request.url);
+
+    HttpResponse response;
+    CURL* curl = acquire_handle();
+    TransferContext context{curl, on_data, &response, request.expected_status, nullptr};
+    struct curl_slist* header_list = nullptr;
+
+    for (const auto& header : request.headers) {
+        header_list = curl_slist_append(header_list, header.c_str());
+    }
+
+    curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+    curl_easy_setopt(curl, CURLOPT_URL, request.url.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_list);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &context);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, HeaderCallback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &response.headers);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, request.timeout);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    // every transfer runs on its own easy handle and connection, HTTP/2 is
+    // never multiplexed here and only saves on headers
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+
+    if (request.head) {
+        curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    }
+
+    if (request.cancel || (request.progress && request.progress->active())) {
+        context.cancel = request.cancel;
+        context.progress = request.progress;
+        context.progress_base = request.progress ? request.progress->get_bytes() : 0;
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, TransferInfoCallback);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &context);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    }
+
+    if (request.stall_timeout > 0) {
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, request.stall_timeout);
+    }
+
+    CURLcode res = curl_easy_perform(curl);
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response.status_code);
+
+    char* effective_url = nullptr;
+    if (curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &effective_url) == CURLE_OK && effective_url) {
+        response.effective_url = effective_url;
+    }
+
+    if (span.active()) {
+        span.set_arg("status", static_cast<double>(response.status_code));
+        add_timing_args(curl, span);
+    }
+
+    release_handle(curl);
+    curl_slist_free_all(header_list);
+
+    if (context.error) {
+        std::rethrow_exception(context.error);
+    }
+
+    if (res != CURLE_OK) {
+        throw std::runtime_error("Curl request failed: " + std::string(curl_easy_strerror(res)));
+    }
+
+    return response;
+}
@@ -0,0 +1,318 @@
+#include "InstallManifest.hpp"
+#include "CacheDir.hpp"
+#include "Checksum.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+#include <sys/stat.h>
+
+static constexpr const char* kManifestName = ".geode-installer.manifest";
+static constexpr char kMagic[4] = {'G', 'D', 'I', 'M'};
+static constexpr uint32_t kVersion = 1;
+
+static void put_u32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+static void put_u64(std::string& out, uint64_t value) {
+    put_u32(out, static_cast<uint32_t>(value));
+    put_u32(out, static_cast<uint32_t>(value >> 32));
+}
+
+static void put_string(std::string& out, const std::string& value) {
+    put_u32(out, static_cast<uint32_t>(value.size()));
+    out += value;
+}
+
+// little endian fields read front to back, every read is bounds checked
+class ManifestReader {
+public:
+    explicit ManifestReader(const std::string& data) : data_(data) {}
+
+    uint32_t u32() {
+        need(4);
+        uint32_t value = 0;
+        for (int i = 0; i < 4; i++) {
+            value |= static_cast<uint32_t>(static_cast<unsigned char>(data_[pos_ + i])) << (8 * i);
+        }
+        pos_ += 4;
+        return value;
+    }
+
+    uint64_t u64() {
+        uint64_t low = u32();
+        return low | static_cast<uint64_t>(u32()) << 32;
+    }
+
+    std::string string() {
+        uint32_t size = u32();
+        need(size);
+        std::string value = data_.substr(pos_, size);
+        pos_ += size;
+        return value;
+    }
+
+private:
+    void need(size_t size) const {
+        if (data_.size() - pos_ < size) {
+            throw std::runtime_error("Install manifest is truncated");
+        }
+    }
+
+    const std::string& data_;
+    size_t pos_ = 0;
+};
+
+// uninstall deletes what the manifest lists, so nothing may point outside gd_path
+static bool is_contained_path(const std::string& path) {
+    fs::path relative(path);
+    if (relative.empty() || relative.is_absolute()) {
+        return false;
+    }
+    for (const auto& part : relative) {
+        if (part == "..") {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int64_t mtime_ns(const struct stat& st) {
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+fs::path InstallManifest::path_in(const fs::path& gd_path) {
+    return gd_path / kManifestName;
+}
+
+InstallManifest InstallManifest::record(const fs::path& gd_path, const std::vector<std::string>& files,
+                                        size_t thread_count) {
+    TraceSpan span("record_manifest", "install");
+    span.set_arg("files", static_cast<double>(files.size()));
+
+    InstallManifest manifest;
+    manifest.files.resize(files.size());
+
+    parallel_for(files.size(), thread_count, [&](size_t i) {
+        ManifestFile& file = manifest.files[i];
+        file.path = files[i];
+        if (!is_contained_path(file.path)) {
+            throw std::runtime_error("Installed file outside the game directory: " + file.path);
+        }
+
+        fs::path path = gd_path / file.path;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            throw std::runtime_error("Failed to stat installed file: " + path.string());
+        }
+
+        std::optional<uint32_t> crc = crc32_of_file(path);
+        if (!crc) {
+            throw std::runtime_error("Failed to read installed file: " + path.string());
+        }
+
+        file.size = static_cast<uint64_t>(st.st_size);
+        file.mtime_ns = mtime_ns(st);
+        file.crc = *crc;
+    });
+
+    return manifest;
+}
+
+std::optional<InstallManifest> InstallManifest::load(const fs::path& gd_path) {
+    fs::path path = path_in(gd_path);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // the last four bytes are the CRC32 of everything before them
+    if (data.size() < sizeof(kMagic) + 8 || !std::equal(kMagic, kMagic + sizeof(kMagic), data.begin())) {
+        throw std::runtime_error("Not an install manifest: " + path.string());
+    }
+    std::string trailer = data.substr(data.size() - 4);
+    data.resize(data.size() - 4);
+    if (ManifestReader(trailer).u32() != update_crc32(0, data.data(), data.size())) {
+        throw std::runtime_error("Install manifest is damaged: " + path.string());
+    }
+
+    ManifestReader reader(data);
+    reader.u32();
+    if (reader.u32() != kVersion) {
+        throw std::runtime_error("Unsupported install manifest version: " + path.string());
+    }
+
+    InstallManifest manifest;
+    manifest.tag = reader.string();
+    manifest.registry_file = reader.string();
+
+    uint32_t edit_count = reader.u32();
+    for (uint32_t i = 0; i < edit_count; i++) {
+        RegistryEdit edit;
+        edit.section = reader.string();
+        edit.name = reader.string();
+        edit.value = reader.string();
+        manifest.registry_edits.push_back(std::move(edit));
+    }
+
+    uint32_t file_count = reader.u32();
+    for (uint32_t i = 0; i < file_count; i++) {
+        ManifestFile entry;
+        entry.path = reader.string();
+        if (!is_contained_path(entry.path)) {
+            throw std::runtime_error("Install manifest is damaged: " + path.string());
+        }
+        entry.size = reader.u64();
+        entry.mtime_ns = static_cast<int64_t>(reader.u64());
+        entry.crc = reader.u32();
+        manifest.files.push_back(std::move(entry));
+    }
+
+    return manifest;
+}
+
+void InstallManifest::save(const fs::path& gd_path) const {
+    std::string data(kMagic, sizeof(kMagic));
+    put_u32(data, kVersion);
+    put_string(data, tag);
+    put_string(data, registry_file.string());
+
+    put_u32(data, static_cast<uint32_t>(registry_edits.size()));
+    for (const auto& edit : registry_edits) {
+        put_string(data, edit.section);
+        put_string(data, edit.name);
+        put_string(data, edit.value);
+    }
+
+    put_u32(data, static_cast<uint32_t>(files.size()));
+    for (const auto& file : files) {
+        put_string(data, file.path);
+        put_u64(data, file.size);
+        put_u64(data, static_cast<uint64_t>(file.mtime_ns));
+        put_u32(data, file.crc);
+    }
+
+    put_u32(data, update_crc32(0, data.data(), data.size()));
+
+    fs::path path = path_in(gd_path);
+    if (!write_file_atomically(path, data)) {
+        throw std::runtime_error("Failed to write install manifest: " + path.string());
+    }
+}
+
+VerifyResult InstallManifest::verify(const fs::path& gd_path, size_t thread_count) const {
+    TraceSpan span("verify_install", "verify");
+
+    enum class State : char { Intact, Hashed, Missing, Modified };
+    std::vector<State> states(files.size(), State::Intact);
+
+    parallel_for(files.size(), thread_count, [&](size_t i) {
+        const ManifestFile& file = files[i];
+        fs::path path = gd_path / file.path;
+
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            states[i] = State::Missing;
+        } else if (static_cast<uint64_t>(st.st_size) != file.size) {
+            states[i] = State::Modified;
+        } else if (mtime_ns(st) != file.mtime_ns) {
+            // touched, but possibly with the same contents
+            std::optional<uint32_t> crc = crc32_of_file(path);
+            states[i] = crc && *crc == file.crc ? State::Hashed : State::Modified;
+        }
+    });
+
+    VerifyResult result;
+    result.checked = files.size();
+    for (size_t i = 0; i < files.size(); i++) {
+        switch (states[i]) {
+            case State::Intact:
+                break;
+            case State::Hashed:
+                result.hashed++;
+                break;
+            case State::Missing:
+                result.missing.push_back(files[i].path);
+                break;
+            case State::Modified:
+                result.hashed++;
+                result.modified.push_back(files[i].path);
+                break;
+        }
+    }
+
+    // any value counts as present, like the install a user's own choice is kept
+    if (!registry_edits.empty()) {
+        WineRegistry registry(registry_file);
+        for (const auto& edit : registry_edits) {
+            if (!registry.get_value(edit.section, edit.name)) {
+                result.missing_registry.push_back(edit.name);
+            }
+        }
+    }
+
+    span.set_arg("files", static_cast<double>(result.checked));
+    span.set_arg("hashed", static_cast<double>(result.hashed));
+    return result;
+}
+
+UninstallResult InstallManifest::uninstall(const fs::path& gd_path) const {
+    TraceSpan span("uninstall", "install");
+
+    UninstallResult result;
+    result.registry_file = registry_file;
+    std::set<fs::path> directories;
+
+    for (const auto& file : files) {
+        fs::path path = gd_path / file.path;
+
+        std::error_code ec;
+        if (fs::remove(path, ec)) {
+            result.removed++;
+        } else if (ec) {
+            throw std::runtime_error("Failed to remove " + path.string() + ": " + ec.message());
+        } else {
+            result.missing++;
+        }
+
+        for (fs::path parent = fs::path(file.path).parent_path(); !parent.empty(); parent = parent.parent_path()) {
+            directories.insert(gd_path / parent);
+        }
+    }
+
+    // deepest first, so a parent is only looked at once its children are gone
+    for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+        std::error_code ec;
+        if (fs::is_empty(*it, ec) && !ec) {
+            fs::remove(*it, ec);
+        }
+    }
+
+    // a value the user has changed since is theirs now
+    if (!registry_edits.empty() && fs::exists(registry_file)) {
+        WineRegistry registry(registry_file);
+        std::vector<RegistryEdit> reverts;
+        for (const auto& edit : registry_edits) {
+            if (registry.get_value(edit.section, edit.name) == edit.value) {
+                reverts.push_back({edit.section, edit.name, "", RegistryEdit::Action::Remove});
+            }
+        }
+        if (!reverts.empty()) {
+            registry.apply(reverts);
+        }
+        result.reverted_registry = reverts.size();
+    }
+
+    fs::remove(path_in(gd_path));
+
+    span.set_arg("removed", static_cast<double>(result.removed));
+    return result;
+}
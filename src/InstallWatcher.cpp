@@ -0,0 +1,233 @@
+#include "InstallWatcher.hpp"
+#include "InstallManifest.hpp"
+#include "VdfDocument.hpp"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+static constexpr const char* kGeometryDashAppId = "322170";
+// a failed repair (e.g. no network for the download) is retried after this
+static constexpr std::chrono::minutes kRetryDelay{1};
+
+// fully installed, anything else means Steam is downloading, updating or
+// validating the game
+static constexpr std::string_view kStateFullyInstalled = "4";
+
+static constexpr uint32_t kEntryEvents = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+static constexpr uint32_t kDirectoryEvents = kEntryEvents | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+InstallWatcher::InstallWatcher(const GeodeInstaller& installer, const SteamGameFinder& finder,
+                               std::chrono::milliseconds debounce)
+    : installer_(installer), finder_(finder), debounce_(debounce) {
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        throw std::runtime_error("Failed to initialize inotify");
+    }
+
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        close(inotify_fd_);
+        throw std::runtime_error("Failed to create eventfd");
+    }
+}
+
+InstallWatcher::~InstallWatcher() {
+    close(stop_fd_);
+    close(inotify_fd_);
+}
+
+void InstallWatcher::stop() {
+    uint64_t one = 1;
+    ssize_t written = write(stop_fd_, &one, sizeof(one));
+    (void)written;
+}
+
+void InstallWatcher::run() {
+    using Clock = std::chrono::steady_clock;
+
+    bool pending = !check_and_repair();
+    Clock::time_point deadline = Clock::now() + kRetryDelay;
+
+    while (true) {
+        int timeout = -1;
+        if (pending) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now());
+            timeout = static_cast<int>(std::max<int64_t>(0, remaining.count()));
+        }
+
+        pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+        if (poll(fds, 2, timeout) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("Failed to wait for file events");
+        }
+
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+
+        // every relevant event pushes the check back, a Steam update touches
+        // hundreds of files and only the state after the last one matters
+        if ((fds[0].revents & POLLIN) && read_events()) {
+            pending = true;
+            deadline = Clock::now() + debounce_;
+        }
+
+        if (pending && Clock::now() >= deadline) {
+            pending = !check_and_repair();
+            deadline = Clock::now() + kRetryDelay;
+        }
+    }
+}
+
+bool InstallWatcher::read_events() {
+    alignas(inotify_event) char buffer[4096];
+    bool relevant = false;
+
+    while (true) {
+        ssize_t size = read(inotify_fd_, buffer, sizeof(buffer));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            break;
+        }
+
+        for (char* pos = buffer; pos < buffer + size;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(pos);
+            pos += sizeof(inotify_event) + event->len;
+
+            // dropped events could have been anything
+            if (event->mask & IN_Q_OVERFLOW) {
+                relevant = true;
+                continue;
+            }
+
+            auto watch = watches_.find(event->wd);
+            if (watch == watches_.end()) {
+                continue;
+            }
+
+            // the directory itself went away, the next check watches whatever
+            // replaced it
+            if (event->mask & IN_IGNORED) {
+                watches_.erase(watch);
+                relevant = true;
+                continue;
+            }
+
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+                relevant = true;
+                continue;
+            }
+
+            if (watch->second.name.empty() || (event->len > 0 && watch->second.name == event->name)) {
+                relevant = true;
+            }
+        }
+    }
+
+    return relevant;
+}
+
+void InstallWatcher::update_watches(const GameInfo& info) {
+    std::map<fs::path, std::string> wanted;
+
+    // every library, the game can show up or move between them
+    std::string manifest_name = std::string("appmanifest_") + kGeometryDashAppId + ".acf";
+    for (const auto& library : finder_.get_library_folders()) {
+        wanted[library] = manifest_name;
+    }
+    if (info.game_path) {
+        wanted[*info.game_path] = "";
+    }
+    if (info.proton_prefix) {
+        wanted[*info.proton_prefix] = "user.reg";
+    }
+
+    for (auto it = watches_.begin(); it != watches_.end();) {
+        auto match = wanted.find(it->second.directory);
+        if (match != wanted.end() && match->second == it->second.name) {
+            wanted.erase(match);
+            ++it;
+            continue;
+        }
+        inotify_rm_watch(inotify_fd_, it->first);
+        it = watches_.erase(it);
+    }
+
+    for (const auto& [directory, name] : wanted) {
+        // a library that isn't there right now just isn't watched
+        int wd = inotify_add_watch(inotify_fd_, directory.c_str(), kDirectoryEvents);
+        if (wd >= 0) {
+            watches_[wd] = {directory, name};
+        }
+    }
+}
+
+bool InstallWatcher::geode_files_intact(const fs::path& gd_path) const {
+    // installs from before the manifest only have the loader to go by
+    if (!fs::exists(InstallManifest::path_in(gd_path))) {
+        return installer_.is_loader_present(gd_path);
+    }
+
+    try {
+        VerifyResult result = installer_.verify_install(gd_path);
+        return result.missing.empty() && result.modified.empty();
+    } catch (const std::exception&) {
+        // a damaged manifest, the reinstall writes a new one
+        return false;
+    }
+}
+
+bool InstallWatcher::check_and_repair() {
+    try {
+        GameInfo info = finder_.get_game_info(kGeometryDashAppId);
+        update_watches(info);
+
+        if (!info.found) {
+            std::cout << "Waiting for Geometry Dash to be installed..." << std::endl;
+            return true;
+        }
+
+        fs::path manifest_path = *info.library_path / ("appmanifest_" + std::string(kGeometryDashAppId) + ".acf");
+        std::optional<VdfDocument> manifest = VdfDocument::load(manifest_path, {"AppState.StateFlags"});
+        std::optional<std::string_view> state = manifest ? manifest->find("AppState.StateFlags") : std::nullopt;
+
+        if (state && *state != kStateFullyInstalled) {
+            std::cout << "Steam is updating Geometry Dash, waiting for it to finish..." << std::endl;
+            return true;
+        }
+
+        std::optional<std::vector<std::string>> reinstalled;
+        if (!geode_files_intact(*info.game_path)) {
+            std::cout << "Geode is missing or changed in " << info.game_path->string() << ", reinstalling..." << std::endl;
+            reinstalled = installer_.install_to_dir(*info.game_path);
+        }
+
+        // Proton creates the prefix on first launch, until then there's nothing to patch
+        fs::path user_reg = info.proton_prefix ? *info.proton_prefix / "user.reg" : fs::path();
+        bool override_added = false;
+        if (!user_reg.empty() && fs::exists(user_reg) && !installer_.is_prefix_patched(user_reg)) {
+            std::cout << "The xinput1_4 override is gone, patching the Wine registry..." << std::endl;
+            override_added = installer_.patch_prefix_registry(user_reg);
+        }
+
+        // a re-added override alone is already in the manifest from the install.
+        // without a prefix the empty user_reg keeps the recorded registry edits
+        if (reinstalled) {
+            installer_.write_install_manifest(*info.game_path, *reinstalled, user_reg, override_added);
+        }
+
+        return true;
+    } catch (const std::exception& e) {
+        std::cout << "Failed to repair the install: " << e.what() << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,183 @@
+#include "MirrorSelector.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+static constexpr uint64_t kProbeSize = 256 * 1024;
+static constexpr long kProbeTimeout = 10;
+static constexpr long kRaceTimeout = 30;
+// once the fastest probe is done the others get this much longer than it
+// took, anything slower isn't worth waiting for
+static constexpr double kProbeGraceFactor = 2.0;
+static constexpr auto kMinProbeGrace = std::chrono::milliseconds(250);
+
+// thrown from the data callback once a probe has seen enough
+struct ProbeComplete {};
+
+MirrorSelector::MirrorSelector(HttpClient& client) : client_(client) {}
+
+HttpResponse MirrorSelector::race(const std::vector<std::string>& base_urls, const std::string& path,
+                                  const std::vector<std::string>& headers,
+                                  const std::function<bool(const HttpResponse&)>& accept) const {
+    if (base_urls.size() == 1) {
+        return client_.get({base_urls.front() + path, headers, kRaceTimeout});
+    }
+
+    TraceSpan span("mirror_race", "http");
+    span.set_arg("mirrors", static_cast<double>(base_urls.size()));
+
+    std::atomic<bool> done{false};
+    std::mutex result_mutex;
+    std::optional<HttpResponse> winner;
+    std::optional<HttpResponse> last_response;
+    std::exception_ptr last_error;
+    size_t winner_index = 0;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < base_urls.size(); i++) {
+        threads.emplace_back([&, i]() {
+            HttpRequest request{base_urls[i] + path, headers, kRaceTimeout};
+            request.cancel = &done;
+
+            try {
+                HttpResponse response = client_.get(request);
+
+                std::lock_guard lock(result_mutex);
+                if (winner) {
+                    return;
+                }
+                if (accept(response)) {
+                    winner = std::move(response);
+                    winner_index = i;
+                    done = true;
+                } else {
+                    last_response = std::move(response);
+                }
+            } catch (...) {
+                std::lock_guard lock(result_mutex);
+                if (!done) {
+                    last_error = std::current_exception();
+                }
+            }
+        });
+    }
+
+    // the losers notice the flag within a second and abort
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (winner) {
+        span.set_arg("winner", base_urls[winner_index]);
+        return std::move(*winner);
+    }
+    if (last_response) {
+        return std::move(*last_response);
+    }
+    std::rethrow_exception(last_error);
+}
+
+std::vector<MirrorProbe> MirrorSelector::rank(const std::vector<std::string>& base_urls,
+                                              const std::string& path) const {
+    std::vector<MirrorProbe> probes(base_urls.size());
+    for (size_t i = 0; i < base_urls.size(); i++) {
+        probes[i].base_url = base_urls[i];
+    }
+
+    if (base_urls.size() <= 1) {
+        for (auto& probe : probes) {
+            probe.reachable = true;
+        }
+        return probes;
+    }
+
+    TraceSpan span("mirror_probe", "http");
+    span.set_arg("mirrors", static_cast<double>(base_urls.size()));
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+
+    std::atomic<bool> give_up{false};
+    std::mutex finished_mutex;
+    std::condition_variable finished_changed;
+    size_t finished = 0;
+    std::optional<Clock::duration> fastest;
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < base_urls.size(); i++) {
+        threads.emplace_back([&, i]() {
+            TraceSpan probe_span("mirror_probe_request", "http");
+            probe_span.set_arg("url", base_urls[i]);
+
+            HttpRequest request{base_urls[i] + path, {"Range: bytes=0-" + std::to_string(kProbeSize - 1)},
+                                kProbeTimeout};
+            request.cancel = &give_up;
+
+            uint64_t received = 0;
+            bool complete = false;
+
+            try {
+                HttpResponse response = client_.stream(request, [&](const char*, size_t size) {
+                    received += size;
+                    // servers without range support send everything
+                    if (received >= kProbeSize) {
+                        throw ProbeComplete{};
+                    }
+                });
+                complete = response.status_code == 200 || response.status_code == 206;
+            } catch (const ProbeComplete&) {
+                complete = true;
+            } catch (const std::exception&) {
+                complete = false;
+            }
+
+            Clock::duration elapsed = Clock::now() - start;
+            double seconds = std::max(std::chrono::duration<double>(elapsed).count(), 1e-6);
+
+            // a probe cut short by the grace period still counts with what it got
+            probes[i].reachable = complete || received > 0;
+            probes[i].throughput = probes[i].reachable ? received / seconds : 0;
+            probe_span.set_arg("bytes_per_second", probes[i].throughput);
+
+            std::lock_guard lock(finished_mutex);
+            if (complete && !fastest) {
+                fastest = elapsed;
+            }
+            finished++;
+            finished_changed.notify_all();
+        });
+    }
+
+    {
+        std::unique_lock lock(finished_mutex);
+        finished_changed.wait(lock, [&]() { return fastest || finished == threads.size(); });
+
+        if (fastest) {
+            auto grace = std::max<Clock::duration>(
+                std::chrono::duration_cast<Clock::duration>(*fastest * (kProbeGraceFactor - 1)), kMinProbeGrace);
+            finished_changed.wait_until(lock, start + *fastest + grace, [&]() { return finished == threads.size(); });
+        }
+    }
+    give_up = true;
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::stable_sort(probes.begin(), probes.end(), [](const MirrorProbe& a, const MirrorProbe& b) {
+        if (a.reachable != b.reachable) {
+            return a.reachable;
+        }
+        return a.throughput > b.throughput;
+    });
+
+    span.set_arg("selected", probes.front().base_url);
+    return probes;
+}
@@ -0,0 +1,374 @@
+#include "PrefixScanner.hpp"
+#include "CacheDir.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include <json/json.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr int kCacheVersion = 2;
+static constexpr const char* kGameExecutable = "GeometryDash.exe";
+// levels listed below a root while looking for prefixes, enough for
+// ~/Games/Heroic/Prefixes/default/<game>
+static constexpr int kMaxRootDepth = 4;
+// levels listed below a prefix, enough for
+// drive_c/Program Files (x86)/Steam/steamapps/common/Geometry Dash
+static constexpr int kMaxPrefixDepth = 6;
+// listing is mostly waiting on the disk, more threads than cores keep more
+// lookups in flight
+static constexpr size_t kMinDefaultThreads = 8;
+
+struct ScanDirectory {
+    fs::path path;
+    // levels below the root, or below the prefix once inside one
+    int depth = 0;
+    std::optional<fs::path> prefix;
+    size_t root = 0;
+};
+
+struct ListedDirectory {
+    bool listed = false;
+    bool is_prefix = false;
+    bool has_game = false;
+    int64_t mtime = 0;
+    std::vector<ScanDirectory> children;
+};
+
+// roots overlap (~/Games and ~/Games/Heroic), every directory is listed once
+class VisitedDirectories {
+public:
+    bool insert(const struct statx& st) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return visited_.insert({st.stx_dev_major, st.stx_dev_minor, st.stx_ino}).second;
+    }
+
+private:
+    std::mutex mutex_;
+    std::set<std::tuple<uint32_t, uint32_t, uint64_t>> visited_;
+};
+
+static int64_t to_nanoseconds(const statx_timestamp& timestamp) {
+    return static_cast<int64_t>(timestamp.tv_sec) * 1000000000 + timestamp.tv_nsec;
+}
+
+// 0 when it doesn't exist
+static int64_t directory_mtime(const fs::path& path) {
+    struct statx st;
+    if (statx(AT_FDCWD, path.c_str(), AT_STATX_DONT_SYNC, STATX_MTIME, &st) != 0) {
+        return 0;
+    }
+    return to_nanoseconds(st.stx_mtime);
+}
+
+static ListedDirectory list_directory(const ScanDirectory& directory, VisitedDirectories& visited) {
+    ListedDirectory listed;
+
+    // a root may be a symlink to another disk, nothing below one is followed
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (directory.depth > 0 || directory.prefix ? O_NOFOLLOW : 0);
+    int fd = open(directory.path.c_str(), flags);
+    if (fd < 0) {
+        return listed;
+    }
+
+    struct statx st;
+    if (statx(fd, "", AT_EMPTY_PATH | AT_STATX_DONT_SYNC, STATX_INO | STATX_MTIME, &st) != 0) {
+        close(fd);
+        return listed;
+    }
+    listed.mtime = to_nanoseconds(st.stx_mtime);
+
+    if (!visited.insert(st)) {
+        close(fd);
+        return listed;
+    }
+
+    DIR* dir = fdopendir(fd);
+    if (!dir) {
+        close(fd);
+        return listed;
+    }
+
+    std::vector<std::pair<std::string, unsigned char>> entries;
+    std::vector<size_t> untyped;
+
+    while (dirent* entry = readdir(dir)) {
+        std::string_view name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        if (entry->d_type == DT_UNKNOWN) {
+            untyped.push_back(entries.size());
+        }
+        entries.emplace_back(name, entry->d_type);
+    }
+
+    // d_type saves a stat per entry on most filesystems. where it's missing
+    // the entries are looked up together after the listing, relative to the
+    // open directory and without forcing a sync on network mounts
+    for (size_t index : untyped) {
+        struct statx entry_st;
+        if (statx(dirfd(dir), entries[index].first.c_str(), AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, STATX_TYPE,
+                  &entry_st) != 0) {
+            continue;
+        }
+
+        if (S_ISDIR(entry_st.stx_mode)) {
+            entries[index].second = DT_DIR;
+        } else if (S_ISREG(entry_st.stx_mode)) {
+            entries[index].second = DT_REG;
+        } else if (S_ISLNK(entry_st.stx_mode)) {
+            entries[index].second = DT_LNK;
+        }
+    }
+
+    closedir(dir);
+    listed.listed = true;
+
+    bool has_user_reg = false;
+    bool has_drive_c = false;
+    for (const auto& [name, type] : entries) {
+        if (type == DT_REG && name == "user.reg") {
+            has_user_reg = true;
+        } else if (type == DT_DIR && name == "drive_c") {
+            has_drive_c = true;
+        } else if (type == DT_REG && strcasecmp(name.c_str(), kGameExecutable) == 0) {
+            listed.has_game = true;
+        }
+    }
+
+    // a prefix is only entered through drive_c, the rest is Wine's own
+    if (!directory.prefix && has_user_reg && has_drive_c) {
+        listed.is_prefix = true;
+        listed.children.push_back({directory.path / "drive_c", 1, directory.path, directory.root});
+        return listed;
+    }
+
+    if (directory.depth >= (directory.prefix ? kMaxPrefixDepth : kMaxRootDepth)) {
+        return listed;
+    }
+
+    for (const auto& [name, type] : entries) {
+        if (type != DT_DIR || name[0] == '.') {
+            continue;
+        }
+        // thousands of directories that never hold the game
+        if (directory.prefix && directory.depth == 1 && strcasecmp(name.c_str(), "windows") == 0) {
+            continue;
+        }
+        listed.children.push_back({directory.path / name, directory.depth + 1, directory.prefix, directory.root});
+    }
+
+    return listed;
+}
+
+PrefixScanner::PrefixScanner(std::vector<DiscoveryRoot> roots, fs::path cache_path, size_t thread_count)
+    : roots_(std::move(roots)), cache_path_(std::move(cache_path)),
+      thread_count_(thread_count ? thread_count : std::max<size_t>(kMinDefaultThreads, std::thread::hardware_concurrency())) {}
+
+std::vector<DiscoveryRoot> PrefixScanner::default_roots(const fs::path& home) {
+    return {
+        {home / ".wine", "Wine"},
+        {home / ".local" / "share" / "wineprefixes", "Wine"},
+        {home / "Games" / "Heroic", "Heroic"},
+        {home / "Games", "Lutris"},
+        {home / ".local" / "share" / "bottles" / "bottles", "Bottles"},
+        {home / ".var" / "app" / "com.usebottles.bottles" / "data" / "bottles" / "bottles", "Bottles"},
+    };
+}
+
+DiscoveryResult PrefixScanner::scan() const {
+    TraceSpan span("prefix_scan", "discovery");
+
+    DiscoveryResult result;
+    VisitedDirectories visited;
+
+    std::vector<ScanDirectory> level;
+    for (size_t i = 0; i < roots_.size(); i++) {
+        level.push_back({roots_[i].path, 0, std::nullopt, i});
+    }
+
+    // one level at a time, so every root is claimed by its own launcher
+    // before a broader root gets to it
+    size_t listed_count = 0;
+    while (!level.empty()) {
+        std::vector<ListedDirectory> listed(level.size());
+        parallel_for(level.size(), thread_count_, [&](size_t i) {
+            listed[i] = list_directory(level[i], visited);
+        });
+
+        std::vector<ScanDirectory> next;
+        for (size_t i = 0; i < level.size(); i++) {
+            const ScanDirectory& directory = level[i];
+            ListedDirectory& entry = listed[i];
+            const std::string& launcher = roots_[directory.root].launcher;
+
+            // missing roots count too, one showing up later is a change
+            if (directory.depth == 0 && !directory.prefix) {
+                result.mtimes[directory.path] = entry.mtime;
+            }
+            if (!entry.listed) {
+                continue;
+            }
+            listed_count++;
+            // a game or prefix can show up in any directory that was listed
+            result.mtimes[directory.path] = entry.mtime;
+
+            if (entry.is_prefix) {
+                result.prefixes.push_back({directory.path, launcher});
+            }
+            if (entry.has_game) {
+                result.installs.push_back({directory.path, entry.is_prefix ? directory.path : directory.prefix, launcher});
+            }
+
+            std::move(entry.children.begin(), entry.children.end(), std::back_inserter(next));
+        }
+
+        level = std::move(next);
+    }
+
+    std::sort(result.prefixes.begin(), result.prefixes.end(),
+              [](const DiscoveredPrefix& a, const DiscoveredPrefix& b) { return a.path < b.path; });
+    std::sort(result.installs.begin(), result.installs.end(),
+              [](const DiscoveredInstall& a, const DiscoveredInstall& b) { return a.gd_path < b.gd_path; });
+
+    span.set_arg("directories", static_cast<double>(listed_count));
+    span.set_arg("prefixes", static_cast<double>(result.prefixes.size()));
+    span.set_arg("installs", static_cast<double>(result.installs.size()));
+    return result;
+}
+
+DiscoveryResult PrefixScanner::discover(bool rescan) const {
+    if (!rescan) {
+        std::optional<DiscoveryResult> cached = load_cache();
+        if (cached) {
+            return *cached;
+        }
+    }
+
+    DiscoveryResult result = scan();
+    save_cache(result);
+    return result;
+}
+
+std::optional<DiscoveryResult> PrefixScanner::load_cache() const {
+    TraceSpan span("prefix_cache_load", "discovery");
+
+    std::ifstream file(cache_path_);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    Json::Value root;
+    Json::Reader reader;
+
+    if (!reader.parse(buffer.str(), root) || !root.isObject() || root["version"].asInt() != kCacheVersion) {
+        return std::nullopt;
+    }
+
+    // scanned from other roots, e.g. a different $HOME
+    std::vector<std::string> root_paths;
+    for (const auto& scan_root : roots_) {
+        root_paths.push_back(scan_root.path.string());
+    }
+    std::vector<std::string> cached_roots;
+    for (const auto& cached_root : root["roots"]) {
+        cached_roots.push_back(cached_root.asString());
+    }
+    if (cached_roots != root_paths) {
+        return std::nullopt;
+    }
+
+    DiscoveryResult result;
+    result.from_cache = true;
+
+    const Json::Value& mtimes = root["mtimes"];
+    std::vector<std::pair<fs::path, int64_t>> directories;
+    for (const auto& path : mtimes.getMemberNames()) {
+        directories.emplace_back(path, mtimes[path].asInt64());
+    }
+
+    // every directory the scan listed, stat'ed across the threads like the
+    // listing itself
+    std::atomic<bool> changed{false};
+    parallel_for(directories.size(), thread_count_, [&](size_t i) {
+        if (!changed && directory_mtime(directories[i].first) != directories[i].second) {
+            changed = true;
+        }
+    });
+    if (changed) {
+        return std::nullopt;
+    }
+    result.mtimes.insert(directories.begin(), directories.end());
+
+    for (const auto& entry : root["prefixes"]) {
+        result.prefixes.push_back({entry["path"].asString(), entry["launcher"].asString()});
+    }
+
+    for (const auto& entry : root["installs"]) {
+        DiscoveredInstall install;
+        install.gd_path = entry["gd_path"].asString();
+        install.launcher = entry["launcher"].asString();
+        if (!entry["prefix"].asString().empty()) {
+            install.prefix = entry["prefix"].asString();
+        }
+
+        // uninstalling a game doesn't have to touch anything that was stat'ed
+        std::error_code ec;
+        if (!fs::is_directory(install.gd_path, ec)) {
+            return std::nullopt;
+        }
+        result.installs.push_back(std::move(install));
+    }
+
+    span.set_arg("installs", static_cast<double>(result.installs.size()));
+    return result;
+}
+
+bool PrefixScanner::save_cache(const DiscoveryResult& result) const {
+    Json::Value root;
+    root["version"] = kCacheVersion;
+
+    root["roots"] = Json::Value(Json::arrayValue);
+    for (const auto& scan_root : roots_) {
+        root["roots"].append(scan_root.path.string());
+    }
+
+    root["mtimes"] = Json::Value(Json::objectValue);
+    for (const auto& [path, mtime] : result.mtimes) {
+        root["mtimes"][path.string()] = Json::Int64(mtime);
+    }
+
+    root["prefixes"] = Json::Value(Json::arrayValue);
+    for (const auto& prefix : result.prefixes) {
+        Json::Value entry;
+        entry["path"] = prefix.path.string();
+        entry["launcher"] = prefix.launcher;
+        root["prefixes"].append(entry);
+    }
+
+    root["installs"] = Json::Value(Json::arrayValue);
+    for (const auto& install : result.installs) {
+        Json::Value entry;
+        entry["gd_path"] = install.gd_path.string();
+        entry["prefix"] = install.prefix ? install.prefix->string() : "";
+        entry["launcher"] = install.launcher;
+        root["installs"].append(entry);
+    }
+
+    Json::StreamWriterBuilder builder;
+    return write_file_atomically(cache_path_, Json::writeString(builder, root));
+}
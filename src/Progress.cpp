@@ -0,0 +1,297 @@
+#include "Progress.hpp"
+#include <json/json.h>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr auto kTickInterval = std::chrono::milliseconds(100);
+// progress events are rate limited, start and end events never are
+static constexpr auto kNdjsonInterval = std::chrono::milliseconds(250);
+// weight of the newest sample in the smoothed rate
+static constexpr double kRateSmoothing = 0.3;
+static constexpr int kBarWidth = 20;
+
+struct ProgressCounters {
+    const char* name = "";
+    Clock::time_point start;
+    Clock::time_point end;
+
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> total_bytes{0};
+    std::atomic<uint64_t> items{0};
+    std::atomic<uint64_t> total_items{0};
+    // end is written before this is set
+    std::atomic<bool> finished{false};
+
+    // only touched by the reporter thread
+    bool start_reported = false;
+    bool end_reported = false;
+    uint64_t sampled_bytes = 0;
+    Clock::time_point sampled_at;
+    double rate = 0;
+};
+
+static std::atomic<bool> g_progress_enabled{false};
+static std::mutex g_phases_mutex;
+static std::vector<std::shared_ptr<ProgressCounters>> g_phases;
+
+bool progress_enabled() {
+    return g_progress_enabled.load(std::memory_order_relaxed);
+}
+
+ProgressPhase::ProgressPhase(const char* name, uint64_t total_bytes, uint64_t total_items) {
+    if (!progress_enabled()) {
+        return;
+    }
+
+    counters_ = std::make_shared<ProgressCounters>();
+    counters_->name = name;
+    counters_->start = Clock::now();
+    counters_->total_bytes = total_bytes;
+    counters_->total_items = total_items;
+
+    std::lock_guard<std::mutex> lock(g_phases_mutex);
+    g_phases.push_back(counters_);
+}
+
+ProgressPhase::~ProgressPhase() {
+    if (counters_) {
+        counters_->end = Clock::now();
+        counters_->finished.store(true, std::memory_order_release);
+    }
+}
+
+void ProgressPhase::set_total(uint64_t bytes) {
+    if (counters_) {
+        counters_->total_bytes.store(bytes, std::memory_order_relaxed);
+    }
+}
+
+void ProgressPhase::set_total_if_unknown(uint64_t bytes) {
+    if (counters_) {
+        uint64_t unknown = 0;
+        counters_->total_bytes.compare_exchange_strong(unknown, bytes, std::memory_order_relaxed);
+    }
+}
+
+void ProgressPhase::add_bytes(uint64_t bytes) {
+    if (counters_) {
+        counters_->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+void ProgressPhase::add_items(uint64_t items) {
+    if (counters_) {
+        counters_->items.fetch_add(items, std::memory_order_relaxed);
+    }
+}
+
+uint64_t ProgressPhase::get_bytes() const {
+    return counters_ ? counters_->bytes.load(std::memory_order_relaxed) : 0;
+}
+
+static std::string format_bytes(double bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB"};
+    int unit = 0;
+    while (bytes >= 1024 && unit < 3) {
+        bytes /= 1024;
+        unit++;
+    }
+
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+    return buffer;
+}
+
+static double seconds_between(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+
+static bool write_all(int fd, const std::string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t result = write(fd, text.data() + written, text.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+ProgressSession::ProgressSession(bool bar, int ndjson_fd)
+    : bar_(bar && isatty(STDERR_FILENO)), ndjson_fd_(ndjson_fd), start_(Clock::now()) {
+    g_progress_enabled.store(true, std::memory_order_relaxed);
+    thread_ = std::thread([this]() { run(); });
+}
+
+ProgressSession::~ProgressSession() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_one();
+    thread_.join();
+
+    g_progress_enabled.store(false, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(g_phases_mutex);
+    g_phases.clear();
+}
+
+void ProgressSession::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!wakeup_.wait_for(lock, kTickInterval, [&]() { return stopping_; })) {
+        lock.unlock();
+        report(false);
+        lock.lock();
+    }
+    lock.unlock();
+    report(true);
+}
+
+void ProgressSession::report(bool final) {
+    Clock::time_point now = Clock::now();
+
+    std::vector<std::shared_ptr<ProgressCounters>> phases;
+    {
+        std::lock_guard<std::mutex> lock(g_phases_mutex);
+        phases = g_phases;
+    }
+
+    bool ndjson_due = final || now - last_ndjson_ >= kNdjsonInterval;
+    std::string events;
+    std::string bar_line;
+    std::string finished_lines;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    auto add_event = [&](Json::Value event, double time) {
+        event["time"] = time;
+        events += Json::writeString(builder, event) + "\n";
+    };
+
+    for (const auto& phase : phases) {
+        if (!phase->start_reported) {
+            Json::Value event;
+            event["event"] = "start";
+            event["phase"] = phase->name;
+            add_event(event, seconds_between(start_, phase->start));
+
+            phase->start_reported = true;
+            phase->sampled_at = phase->start;
+        }
+
+        bool finished = phase->finished.load(std::memory_order_acquire);
+        uint64_t bytes = phase->bytes.load(std::memory_order_relaxed);
+        uint64_t total = phase->total_bytes.load(std::memory_order_relaxed);
+        uint64_t items = phase->items.load(std::memory_order_relaxed);
+        uint64_t total_items = phase->total_items.load(std::memory_order_relaxed);
+
+        double interval = seconds_between(phase->sampled_at, now);
+        if (interval > 0) {
+            double sample = (bytes - phase->sampled_bytes) / interval;
+            phase->rate = phase->sampled_bytes == 0 ? sample : phase->rate + kRateSmoothing * (sample - phase->rate);
+            phase->sampled_bytes = bytes;
+            phase->sampled_at = now;
+        }
+
+        if (finished) {
+            double seconds = seconds_between(phase->start, phase->end);
+            double average = seconds > 0 ? bytes / seconds : 0;
+
+            Json::Value event;
+            event["event"] = "end";
+            event["phase"] = phase->name;
+            event["bytes"] = Json::UInt64(bytes);
+            event["items"] = Json::UInt64(items);
+            event["seconds"] = seconds;
+            event["rate"] = average;
+            add_event(event, seconds_between(start_, phase->end));
+
+            // download: 11.7 MiB in 1.2s, 9.8 MiB/s
+            char timing[32];
+            snprintf(timing, sizeof(timing), " in %.1fs, ", seconds);
+            finished_lines += std::string(phase->name) + ": " + format_bytes(bytes);
+            if (items > 0) {
+                finished_lines += ", " + std::to_string(items) + " files";
+            }
+            finished_lines += timing + format_bytes(average) + "/s\n";
+            phase->end_reported = true;
+            continue;
+        }
+
+        double eta = total > bytes && phase->rate > 0 ? (total - bytes) / phase->rate : -1;
+
+        if (ndjson_due) {
+            Json::Value event;
+            event["event"] = "progress";
+            event["phase"] = phase->name;
+            event["bytes"] = Json::UInt64(bytes);
+            if (total > 0) {
+                event["total"] = Json::UInt64(total);
+            }
+            event["items"] = Json::UInt64(items);
+            if (total_items > 0) {
+                event["total_items"] = Json::UInt64(total_items);
+            }
+            event["rate"] = phase->rate;
+            if (eta >= 0) {
+                event["eta"] = eta;
+            }
+            add_event(event, seconds_between(start_, now));
+        }
+
+        // download [########------------]  40% 4.7/11.7 MiB 9.8 MiB/s ETA 1s
+        std::string line = phase->name;
+        if (total > 0) {
+            int filled = static_cast<int>(kBarWidth * std::min<uint64_t>(bytes, total) / total);
+            char percent[16];
+            snprintf(percent, sizeof(percent), " %3d%% ", static_cast<int>(100 * std::min<uint64_t>(bytes, total) / total));
+            line += " [" + std::string(filled, '#') + std::string(kBarWidth - filled, '-') + "]" + percent +
+                    format_bytes(bytes) + " of " + format_bytes(total);
+        } else {
+            line += " " + format_bytes(bytes);
+        }
+        if (items > 0) {
+            line += ", " + std::to_string(items) + (total_items > 0 ? "/" + std::to_string(total_items) : "") + " files";
+        }
+        line += ", " + format_bytes(phase->rate) + "/s";
+        if (eta >= 0) {
+            line += ", ETA " + std::to_string(static_cast<int>(eta + 0.5)) + "s";
+        }
+        bar_line += (bar_line.empty() ? "" : " | ") + line;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_phases_mutex);
+        g_phases.erase(std::remove_if(g_phases.begin(), g_phases.end(),
+                                      [](const auto& phase) { return phase->end_reported; }),
+                       g_phases.end());
+    }
+
+    if (ndjson_fd_ >= 0 && !events.empty() && !write_all(ndjson_fd_, events)) {
+        // the reader went away, the install carries on without it
+        ndjson_fd_ = -1;
+    }
+    if (ndjson_due) {
+        last_ndjson_ = now;
+    }
+
+    if (bar_) {
+        std::string output = bar_drawn_ ? "\r\033[K" : "";
+        output += finished_lines;
+        if (!final) {
+            output += bar_line;
+        }
+        bar_drawn_ = !final && !bar_line.empty();
+        write_all(STDERR_FILENO, output);
+    }
+}
@@ -0,0 +1,45 @@
+#include "ReleaseCache.hpp"
+#include "CacheDir.hpp"
+#include <json/json.h>
+#include <fstream>
+#include <sstream>
+
+ReleaseCache::ReleaseCache(fs::path file_path) : file_path_(std::move(file_path)) {}
+
+std::optional<CachedRelease> ReleaseCache::load() const {
+    std::ifstream file(file_path_);
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    Json::Value root;
+    Json::Reader reader;
+
+    if (!reader.parse(buffer.str(), root) || !root.isObject() || root["tag"].asString().empty()) {
+        return std::nullopt;
+    }
+
+    CachedRelease release;
+    release.api_url = root["api_url"].asString();
+    release.tag = root["tag"].asString();
+    release.etag = root["etag"].asString();
+    release.last_modified = root["last_modified"].asString();
+    release.fetched_at = root["fetched_at"].asInt64();
+    return release;
+}
+
+bool ReleaseCache::store(const CachedRelease& release) const {
+    Json::Value root;
+    root["api_url"] = release.api_url;
+    root["tag"] = release.tag;
+    root["etag"] = release.etag;
+    root["last_modified"] = release.last_modified;
+    root["fetched_at"] = Json::Int64(release.fetched_at);
+
+    // concurrent runs never see a half written file
+    Json::StreamWriterBuilder builder;
+    return write_file_atomically(file_path_, Json::writeString(builder, root));
+}
@@ -0,0 +1,350 @@
+#include "ReleaseStore.hpp"
+#include "CacheDir.hpp"
+#include "Checksum.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static constexpr const char* kManifestHeader = "geode-store 1";
+static constexpr size_t kCopyChunkSize = 1024 * 1024;
+
+ReleaseStore::ReleaseStore(fs::path root, bool allow_hardlinks)
+    : root_(std::move(root)), allow_hardlinks_(allow_hardlinks) {}
+
+fs::path ReleaseStore::manifest_path(const std::string& tag) const {
+    std::string name = tag;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return root_ / "releases" / (name + ".manifest");
+}
+
+fs::path ReleaseStore::object_path(const std::string& digest) const {
+    return root_ / "objects" / digest.substr(0, 2) / digest;
+}
+
+std::optional<std::vector<StoreEntry>> ReleaseStore::load_manifest(const std::string& tag) const {
+    std::ifstream file(manifest_path(tag));
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != kManifestHeader) {
+        return std::nullopt;
+    }
+
+    // "d <path>" for directories, "f <sha256> <size> <path>" for files
+    std::vector<StoreEntry> entries;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string kind;
+        StoreEntry entry;
+
+        fields >> kind;
+        if (kind == "f") {
+            fields >> entry.digest >> entry.size;
+            if (entry.digest.size() != 64) {
+                return std::nullopt;
+            }
+        } else if (kind != "d") {
+            return std::nullopt;
+        }
+
+        fields.get();
+        std::getline(fields, entry.path);
+        if (entry.path.empty()) {
+            return std::nullopt;
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    return entries;
+}
+
+void ReleaseStore::write_manifest(const std::string& tag, const std::vector<StoreEntry>& entries) const {
+    std::ostringstream contents;
+    contents << kManifestHeader << "\n";
+    for (const auto& entry : entries) {
+        if (entry.digest.empty()) {
+            contents << "d " << entry.path << "\n";
+        } else {
+            contents << "f " << entry.digest << " " << entry.size << " " << entry.path << "\n";
+        }
+    }
+
+    // a manifest is only ever seen complete
+    fs::path path = manifest_path(tag);
+    if (!write_file_atomically(path, contents.str())) {
+        throw std::runtime_error("Failed to write store manifest: " + path.string());
+    }
+}
+
+bool ReleaseStore::has_release(const std::string& tag) const {
+    std::optional<std::vector<StoreEntry>> entries = load_manifest(tag);
+    if (!entries) {
+        return false;
+    }
+
+    for (const auto& entry : *entries) {
+        if (entry.digest.empty()) {
+            continue;
+        }
+
+        struct stat st;
+        if (stat(object_path(entry.digest).c_str(), &st) != 0 || static_cast<uint64_t>(st.st_size) != entry.size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+fs::path ReleaseStore::create_staging_dir(const std::string& tag) const {
+    static std::atomic<size_t> counter{0};
+
+    std::string name = tag;
+    std::replace(name.begin(), name.end(), '/', '_');
+
+    fs::path staging = root_ / "staging" / (name + "." + std::to_string(getpid()) + "." + std::to_string(counter++));
+    fs::remove_all(staging);
+    fs::create_directories(staging);
+    return staging;
+}
+
+void ReleaseStore::add_release(const std::string& tag, const fs::path& staging_dir, size_t thread_count) const {
+    TraceSpan span("store_add_release", "store");
+
+    std::vector<StoreEntry> entries;
+    for (const auto& item : fs::recursive_directory_iterator(staging_dir)) {
+        StoreEntry entry;
+        entry.path = item.path().lexically_relative(staging_dir).generic_string();
+
+        if (item.is_directory()) {
+            entries.push_back(std::move(entry));
+        } else if (item.is_regular_file()) {
+            entry.size = item.file_size();
+            entry.digest = "-";
+            entries.push_back(std::move(entry));
+        }
+    }
+
+    // directories first so materializing can create them in one pass,
+    // then the biggest files so the parallel passes don't end on a DLL
+    std::sort(entries.begin(), entries.end(), [](const StoreEntry& a, const StoreEntry& b) {
+        if (a.digest.empty() != b.digest.empty()) {
+            return a.digest.empty();
+        }
+        if (a.size != b.size) {
+            return a.size > b.size;
+        }
+        return a.path < b.path;
+    });
+
+    std::atomic<size_t> added{0};
+
+    parallel_for(entries.size(), thread_count, [&](size_t i) {
+        StoreEntry& entry = entries[i];
+        if (entry.digest.empty()) {
+            return;
+        }
+
+        fs::path file = staging_dir / entry.path;
+        std::optional<std::string> digest = sha256_of_file(file);
+        if (!digest) {
+            throw std::runtime_error("Failed to read " + file.string());
+        }
+        entry.digest = *digest;
+
+        // identical content from an earlier release is kept as it is
+        fs::path object = object_path(entry.digest);
+        if (fs::exists(object)) {
+            return;
+        }
+
+        std::error_code ec;
+        fs::create_directories(object.parent_path(), ec);
+        fs::rename(file, object, ec);
+        if (ec) {
+            throw std::runtime_error("Failed to add " + entry.path + " to the store: " + ec.message());
+        }
+        added++;
+    });
+
+    write_manifest(tag, entries);
+    fs::remove_all(staging_dir);
+
+    span.set_arg("files", static_cast<double>(entries.size()));
+    span.set_arg("new_objects", static_cast<double>(added.load()));
+}
+
+ReleaseStore::Placement ReleaseStore::place_file(const fs::path& object, const fs::path& target) const {
+    struct stat object_st;
+    if (stat(object.c_str(), &object_st) != 0) {
+        throw std::runtime_error("Store object is missing: " + object.string());
+    }
+
+    // the old file is unlinked, never truncated. it may be a hardlink into
+    // the store from an earlier install
+    struct stat target_st;
+    if (lstat(target.c_str(), &target_st) == 0) {
+        if (target_st.st_dev == object_st.st_dev && target_st.st_ino == object_st.st_ino) {
+            return Placement::Unchanged;
+        }
+        if (unlink(target.c_str()) != 0) {
+            throw std::runtime_error("Failed to replace " + target.string());
+        }
+    }
+
+    int source_fd = open(object.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source_fd < 0) {
+        throw std::runtime_error("Failed to open store object: " + object.string());
+    }
+
+    auto create_target = [&]() {
+        int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            close(source_fd);
+            throw std::runtime_error("Failed to create output file: " + target.string());
+        }
+        return fd;
+    };
+
+    int target_fd = create_target();
+
+    // shares the extents, works on btrfs, xfs and bcachefs within one filesystem
+    if (ioctl(target_fd, FICLONE, source_fd) == 0) {
+        close(target_fd);
+        close(source_fd);
+        return Placement::Reflinked;
+    }
+
+    if (allow_hardlinks_) {
+        close(target_fd);
+        unlink(target.c_str());
+
+        if (link(object.c_str(), target.c_str()) == 0) {
+            close(source_fd);
+            return Placement::Hardlinked;
+        }
+        target_fd = create_target();
+    }
+
+    // an in-kernel copy, which some filesystems turn into a server side or
+    // reflinked copy on their own. plain read/write when it can't be used
+    uint64_t remaining = static_cast<uint64_t>(object_st.st_size);
+    bool use_copy_file_range = true;
+    std::vector<char> buffer;
+    off_t offset = 0;
+
+    while (remaining > 0) {
+        ssize_t copied;
+        if (use_copy_file_range) {
+            copied = copy_file_range(source_fd, nullptr, target_fd, nullptr,
+                                     std::min<uint64_t>(remaining, kCopyChunkSize), 0);
+            if (copied < 0 && offset == 0 &&
+                (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+                use_copy_file_range = false;
+                buffer.resize(kCopyChunkSize);
+                continue;
+            }
+        } else {
+            copied = pread(source_fd, buffer.data(), std::min<uint64_t>(remaining, buffer.size()), offset);
+            if (copied > 0 && write(target_fd, buffer.data(), copied) != copied) {
+                copied = -1;
+            }
+        }
+
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            close(target_fd);
+            close(source_fd);
+            throw std::runtime_error("Failed to copy " + object.string() + " to " + target.string());
+        }
+
+        remaining -= copied;
+        offset += copied;
+    }
+
+    close(source_fd);
+    if (close(target_fd) != 0) {
+        throw std::runtime_error("Failed to write output file: " + target.string());
+    }
+    return Placement::Copied;
+}
+
+MaterializeStats ReleaseStore::materialize(const std::string& tag, const fs::path& destination,
+                                           size_t thread_count) const {
+    TraceSpan span("store_materialize", "store");
+
+    std::optional<std::vector<StoreEntry>> entries = load_manifest(tag);
+    if (!entries) {
+        throw std::runtime_error("Release " + tag + " is not in the store");
+    }
+
+    fs::create_directories(destination);
+
+    std::set<fs::path> directories;
+    std::vector<const StoreEntry*> files;
+    for (const auto& entry : *entries) {
+        if (entry.digest.empty()) {
+            directories.insert(destination / entry.path);
+        } else {
+            directories.insert((destination / entry.path).parent_path());
+            files.push_back(&entry);
+        }
+    }
+
+    for (const auto& directory : directories) {
+        fs::create_directories(directory);
+    }
+
+    std::atomic<size_t> reflinked{0};
+    std::atomic<size_t> hardlinked{0};
+    std::atomic<size_t> copied{0};
+    std::atomic<size_t> unchanged{0};
+
+    parallel_for(files.size(), thread_count, [&](size_t i) {
+        const StoreEntry& entry = *files[i];
+
+        switch (place_file(object_path(entry.digest), destination / entry.path)) {
+            case Placement::Reflinked:
+                reflinked++;
+                break;
+            case Placement::Hardlinked:
+                hardlinked++;
+                break;
+            case Placement::Copied:
+                copied++;
+                break;
+            case Placement::Unchanged:
+                unchanged++;
+                break;
+        }
+    });
+
+    MaterializeStats stats;
+    stats.reflinked = reflinked;
+    stats.hardlinked = hardlinked;
+    stats.copied = copied;
+    stats.unchanged = unchanged;
+    for (const StoreEntry* entry : files) {
+        stats.files.push_back(entry->path);
+    }
+
+    span.set_arg("files", static_cast<double>(files.size()));
+    span.set_arg("reflinked", static_cast<double>(stats.reflinked));
+    span.set_arg("hardlinked", static_cast<double>(stats.hardlinked));
+    span.set_arg("copied", static_cast<double>(stats.copied));
+    return stats;
+}
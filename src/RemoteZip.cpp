@@ -0,0 +1,255 @@
+#include "RemoteZip.hpp"
+#include "ZipFormat.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include "Progress.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+// the end record with the longest possible comment, plus the zip64 locator
+// in front of it
+static constexpr uint64_t kTailSize = kEndOfCentralDirSize + 0xFFFF + kZip64LocatorSize;
+
+// a gap smaller than this costs less to download than another request
+static constexpr uint64_t kRangeMergeGap = 256 * 1024;
+static constexpr size_t kRangeFetchThreads = 4;
+
+// "bytes <first>-<last>/<total>"
+static bool parse_content_range(const std::string& value, uint64_t& first, uint64_t& last, uint64_t& total) {
+    try {
+        size_t dash = value.find('-');
+        size_t slash = value.find('/');
+        if (value.rfind("bytes ", 0) != 0 || dash == std::string::npos || slash == std::string::npos || slash < dash) {
+            return false;
+        }
+        first = std::stoull(value.substr(6, dash - 6));
+        last = std::stoull(value.substr(dash + 1, slash - dash - 1));
+        total = std::stoull(value.substr(slash + 1));
+        return first <= last && last < total;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+RemoteZip::RemoteZip(HttpClient& client, const std::string& url) : client_(client), url_(url) {
+    TraceSpan span("remote_zip_directory", "download");
+
+    HttpRequest request{url_, {"Range: bytes=-" + std::to_string(kTailSize)}, 60};
+    request.stall_timeout = kStallTimeout;
+    request.expected_status = 206;
+
+    std::string tail;
+    HttpResponse response = client_.stream(request, [&](const char* data, size_t size) {
+        if (tail.size() + size > kTailSize) {
+            throw std::runtime_error("Server sent more data than requested");
+        }
+        tail.append(data, size);
+    });
+
+    uint64_t tail_first = 0;
+    uint64_t tail_last = 0;
+    if (response.status_code != 206 ||
+        !parse_content_range(response.headers["content-range"], tail_first, tail_last, size_) ||
+        tail.size() != tail_last - tail_first + 1) {
+        throw std::runtime_error("Server does not support range requests");
+    }
+    fetched_bytes_ += tail.size();
+
+    // later ranges skip the redirect and must come from the same file
+    if (!response.effective_url.empty()) {
+        url_ = response.effective_url;
+    }
+    etag_ = response.headers["etag"];
+
+    // the end record is the last signature whose comment runs exactly to the end
+    size_t end_record = std::string::npos;
+    for (size_t pos = tail.size() >= kEndOfCentralDirSize ? tail.size() - kEndOfCentralDirSize + 1 : 0; pos-- > 0;) {
+        if (read_u32(tail, pos) == kEndOfCentralDirSignature &&
+            pos + kEndOfCentralDirSize + read_u16(tail, pos + 20) == tail.size()) {
+            end_record = pos;
+            break;
+        }
+    }
+    if (end_record == std::string::npos) {
+        throw std::runtime_error("Failed to find the end of the zip central directory");
+    }
+
+    uint64_t entry_count = read_u16(tail, end_record + 10);
+    uint64_t directory_size = read_u32(tail, end_record + 12);
+    uint64_t directory_offset = read_u32(tail, end_record + 16);
+
+    if (end_record >= kZip64LocatorSize && read_u32(tail, end_record - kZip64LocatorSize) == kZip64LocatorSignature) {
+        uint64_t record_offset = read_u64(tail, end_record - kZip64LocatorSize + 8);
+        if (record_offset + kZip64EndOfCentralDirSize > size_) {
+            throw std::runtime_error("Invalid zip64 end of central directory locator");
+        }
+
+        std::string record = record_offset >= tail_first
+            ? tail.substr(record_offset - tail_first, kZip64EndOfCentralDirSize)
+            : fetch_range(record_offset, record_offset + kZip64EndOfCentralDirSize - 1);
+        if (record.size() != kZip64EndOfCentralDirSize || read_u32(record, 0) != kZip64EndOfCentralDirSignature) {
+            throw std::runtime_error("Invalid zip64 end of central directory");
+        }
+
+        entry_count = read_u64(record, 32);
+        directory_size = read_u64(record, 40);
+        directory_offset = read_u64(record, 48);
+    }
+
+    if (directory_offset + directory_size > size_) {
+        throw std::runtime_error("Invalid zip central directory offset");
+    }
+
+    std::string directory;
+    if (directory_offset >= tail_first) {
+        directory = tail.substr(directory_offset - tail_first, directory_size);
+    } else if (directory_size > 0) {
+        directory = fetch_range(directory_offset, directory_offset + directory_size - 1);
+    }
+
+    parse_central_directory(directory, directory_offset, entry_count);
+
+    span.set_arg("entries", static_cast<double>(entries_.size()));
+    span.set_arg("bytes", static_cast<double>(fetched_bytes_.load()));
+}
+
+void RemoteZip::parse_central_directory(const std::string& directory, uint64_t directory_offset,
+                                        uint64_t entry_count) {
+    size_t pos = 0;
+    for (uint64_t i = 0; i < entry_count; i++) {
+        if (pos + kCentralHeaderSize > directory.size() || read_u32(directory, pos) != kCentralHeaderSignature) {
+            throw std::runtime_error("Invalid zip central directory entry");
+        }
+
+        uint16_t name_length = read_u16(directory, pos + 28);
+        uint16_t extra_length = read_u16(directory, pos + 30);
+        uint16_t comment_length = read_u16(directory, pos + 32);
+        if (pos + kCentralHeaderSize + name_length + extra_length + comment_length > directory.size()) {
+            throw std::runtime_error("Invalid zip central directory entry");
+        }
+
+        RemoteZipEntry entry;
+        entry.crc = read_u32(directory, pos + 16);
+        uint64_t compressed_size = read_u32(directory, pos + 20);
+        entry.uncompressed_size = read_u32(directory, pos + 24);
+        entry.offset = read_u32(directory, pos + 42);
+        entry.name = directory.substr(pos + kCentralHeaderSize, name_length);
+
+        // the zip64 field only holds the values that didn't fit, in this order
+        size_t extra_pos = pos + kCentralHeaderSize + name_length;
+        size_t extra_end = extra_pos + extra_length;
+        while (extra_pos + 4 <= extra_end) {
+            uint16_t header_id = read_u16(directory, extra_pos);
+            uint16_t data_size = read_u16(directory, extra_pos + 2);
+            size_t field = extra_pos + 4;
+            size_t field_end = std::min(field + data_size, extra_end);
+
+            if (header_id == 0x0001) {
+                if (entry.uncompressed_size == 0xFFFFFFFF && field + 8 <= field_end) {
+                    entry.uncompressed_size = read_u64(directory, field);
+                    field += 8;
+                }
+                if (compressed_size == 0xFFFFFFFF && field + 8 <= field_end) {
+                    compressed_size = read_u64(directory, field);
+                    field += 8;
+                }
+                if (entry.offset == 0xFFFFFFFF && field + 8 <= field_end) {
+                    entry.offset = read_u64(directory, field);
+                }
+            }
+            extra_pos += 4 + data_size;
+        }
+
+        if (entry.offset + compressed_size > directory_offset) {
+            throw std::runtime_error("Zip entry lies outside the archive: " + entry.name);
+        }
+
+        entries_.push_back(std::move(entry));
+        pos += kCentralHeaderSize + name_length + extra_length + comment_length;
+    }
+
+    // an entry runs up to the next one, which takes in its data descriptor
+    std::sort(entries_.begin(), entries_.end(),
+              [](const RemoteZipEntry& a, const RemoteZipEntry& b) { return a.offset < b.offset; });
+    for (size_t i = 0; i < entries_.size(); i++) {
+        uint64_t end = i + 1 < entries_.size() ? entries_[i + 1].offset : directory_offset;
+        entries_[i].span = end - entries_[i].offset;
+    }
+}
+
+std::string RemoteZip::fetch_range(uint64_t first, uint64_t last, ProgressPhase* progress) {
+    HttpRequest request{url_, {"Range: bytes=" + std::to_string(first) + "-" + std::to_string(last)}, 0};
+    request.stall_timeout = kStallTimeout;
+    request.progress = progress;
+    request.expected_status = 206;
+    // a changed file comes back whole instead, which expected_status rejects
+    if (!etag_.empty()) {
+        request.headers.push_back("If-Range: " + etag_);
+    }
+
+    uint64_t length = last - first + 1;
+    std::string body;
+    body.reserve(length);
+
+    HttpResponse response = client_.stream(request, [&](const char* data, size_t size) {
+        if (body.size() + size > length) {
+            throw std::runtime_error("Server sent more data than requested");
+        }
+        body.append(data, size);
+    });
+
+    uint64_t range_first = 0;
+    uint64_t range_last = 0;
+    uint64_t total = 0;
+    if (response.status_code != 206 ||
+        !parse_content_range(response.headers["content-range"], range_first, range_last, total) ||
+        range_first != first || range_last != last || total != size_ || body.size() != length) {
+        throw std::runtime_error("Server sent a different range than requested");
+    }
+
+    fetched_bytes_ += body.size();
+    return body;
+}
+
+void RemoteZip::fetch_entries(const std::vector<const RemoteZipEntry*>& entries, const HttpDataCallback& on_data) {
+    TraceSpan span("remote_zip_entries", "download");
+
+    std::vector<const RemoteZipEntry*> sorted = entries;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const RemoteZipEntry* a, const RemoteZipEntry* b) { return a->offset < b->offset; });
+
+    // inclusive [first, last] pairs, entries are contiguous so a merged range
+    // is still a run of whole entries
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (const RemoteZipEntry* entry : sorted) {
+        if (entry->span == 0) {
+            continue;
+        }
+        uint64_t last = entry->offset + entry->span - 1;
+        if (!ranges.empty() && entry->offset <= ranges.back().second + 1 + kRangeMergeGap) {
+            ranges.back().second = std::max(ranges.back().second, last);
+        } else {
+            ranges.push_back({entry->offset, last});
+        }
+    }
+
+    uint64_t total = 0;
+    for (const auto& range : ranges) {
+        total += range.second - range.first + 1;
+    }
+    ProgressPhase progress("download", total);
+
+    // fetched a few at a time, passed on in order once they're all here
+    std::vector<std::string> bodies(ranges.size());
+    parallel_for(ranges.size(), kRangeFetchThreads, [&](size_t i) {
+        bodies[i] = fetch_range(ranges[i].first, ranges[i].second, &progress);
+    });
+
+    for (auto& body : bodies) {
+        on_data(body.data(), body.size());
+        body = {};
+    }
+
+    span.set_arg("ranges", static_cast<double>(ranges.size()));
+    span.set_arg("bytes", static_cast<double>(fetched_bytes_.load()));
+}
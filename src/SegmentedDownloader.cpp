@@ -0,0 +1,405 @@
+#include "SegmentedDownloader.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include "Sha256Pipeline.hpp"
+#include "CacheDir.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <condition_variable>
+#include <thread>
+
+static constexpr uint64_t kMinSegmentSize = 1024 * 1024;
+static constexpr int kMaxAttempts = 5;
+static constexpr auto kStateSaveInterval = std::chrono::seconds(1);
+static constexpr size_t kHashReadSize = 1024 * 1024;
+static constexpr auto kHashPollInterval = std::chrono::milliseconds(5);
+
+SegmentedDownloader::SegmentedDownloader(HttpClient& client, size_t segments)
+    : client_(client), segments_(std::max<size_t>(1, segments)) {}
+
+uint64_t SegmentedDownloader::contiguous_size(const std::vector<std::unique_ptr<Segment>>& segments) {
+    uint64_t size = 0;
+    for (const auto& segment : segments) {
+        uint64_t done = segment->done.load();
+        size = segment->start + done;
+        if (segment->start + done < segment->end) {
+            break;
+        }
+    }
+    return size;
+}
+
+std::vector<uint64_t> SegmentedDownloader::snapshot_done(const std::vector<std::unique_ptr<Segment>>& segments) {
+    std::vector<uint64_t> done;
+    done.reserve(segments.size());
+    for (const auto& segment : segments) {
+        done.push_back(segment->done.load());
+    }
+    return done;
+}
+
+std::string SegmentedDownloader::download(const std::string& url, const fs::path& output_path) const {
+    return download(std::vector<std::string>{url}, output_path);
+}
+
+std::string SegmentedDownloader::download(const std::vector<std::string>& urls, const fs::path& output_path) const {
+    if (urls.empty()) {
+        throw std::runtime_error("No download url");
+    }
+
+    TraceSpan span("download", "download");
+    span.set_arg("mirrors", static_cast<double>(urls.size()));
+
+    // the first mirror that answers decides the size and goes first for the
+    // ranges. when none does, the single download tries them all again and
+    // reports why they failed
+    HttpResponse head;
+    size_t head_index = 0;
+    for (; head_index < urls.size(); head_index++) {
+        HttpRequest head_request{urls[head_index], {}};
+        head_request.head = true;
+        try {
+            head = client_.get(head_request);
+            if (head.status_code == 200) {
+                break;
+            }
+        } catch (const std::exception&) {
+        }
+    }
+
+    if (head_index == urls.size()) {
+        span.set_arg("segments", 1);
+        return download_single(urls, output_path);
+    }
+    span.set_arg("head_mirror", static_cast<double>(head_index));
+    const std::string& url = urls[head_index];
+
+    uint64_t size = 0;
+    try {
+        size = std::stoull(head.headers["content-length"]);
+    } catch (const std::exception&) {
+        size = 0;
+    }
+
+    // servers that can't do ranges, or files too small to be worth splitting
+    if (head.headers["accept-ranges"] != "bytes" || size < kMinSegmentSize) {
+        span.set_arg("segments", 1);
+        return download_single(urls, output_path);
+    }
+
+    fs::path state_path = output_path;
+    state_path += ".state";
+
+    DownloadState state;
+    bool resumed = load_state(state_path, state) &&
+                   std::find(urls.begin(), urls.end(), state.url) != urls.end() && state.size == size &&
+                   (state.etag.empty() || head.headers["etag"].empty() || state.etag == head.headers["etag"]) &&
+                   fs::exists(output_path) && fs::file_size(output_path) == size;
+
+    if (!resumed) {
+        state = DownloadState{};
+        state.url = url;
+        state.etag = head.headers["etag"];
+        state.size = size;
+
+        size_t count = std::min<uint64_t>(segments_, size / kMinSegmentSize);
+        uint64_t segment_size = size / count;
+        for (size_t i = 0; i < count; i++) {
+            auto segment = std::make_unique<Segment>();
+            segment->start = i * segment_size;
+            segment->end = i + 1 == count ? size : (i + 1) * segment_size;
+            state.segments.push_back(std::move(segment));
+        }
+    }
+
+    span.set_arg("bytes", static_cast<double>(size));
+    span.set_arg("segments", static_cast<double>(state.segments.size()));
+    span.set_arg("resumed", resumed ? 1 : 0);
+
+    int fd = open(output_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (resumed ? 0 : O_TRUNC), 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file for writing: " + output_path.string());
+    }
+
+    if (!resumed && posix_fallocate(fd, 0, size) != 0 && ftruncate(fd, size) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to allocate " + output_path.string());
+    }
+
+    save_state(state_path, state, snapshot_done(state.segments));
+
+    // the signed CDN url behind github's redirect is good for a while,
+    // skip the redirect on every range
+    std::vector<std::string> range_urls(urls.begin() + head_index, urls.end());
+    range_urls.insert(range_urls.end(), urls.begin(), urls.begin() + head_index);
+    if (!head.effective_url.empty()) {
+        range_urls.front() = head.effective_url;
+    }
+
+    std::mutex saver_mutex;
+    std::condition_variable saver_wakeup;
+    bool finished = false;
+
+    // progress is flushed to disk before it is recorded, so a crash can
+    // only ever lose work, never claim it. bytes written after the snapshot
+    // are left for the next save
+    auto persist = [&]() {
+        std::vector<uint64_t> done = snapshot_done(state.segments);
+        fdatasync(fd);
+        save_state(state_path, state, done);
+    };
+
+    std::thread saver([&]() {
+        std::unique_lock<std::mutex> lock(saver_mutex);
+        while (!saver_wakeup.wait_for(lock, kStateSaveInterval, [&]() { return finished; })) {
+            persist();
+        }
+    });
+
+    auto stop_saver = [&]() {
+        {
+            std::lock_guard<std::mutex> lock(saver_mutex);
+            finished = true;
+        }
+        saver_wakeup.notify_one();
+        saver.join();
+    };
+
+    // ranges finish out of order, so the hash follows the part of the file
+    // that is complete from the start, reading it back from the page cache
+    // while the later ranges are still downloading
+    Sha256Pipeline hasher;
+    std::atomic<bool> hash_aborted{false};
+    std::atomic<bool> hash_failed{false};
+
+    std::thread hash_feeder([&]() {
+        std::vector<char> buffer(kHashReadSize);
+        uint64_t hashed = 0;
+
+        while (hashed < size && !hash_aborted) {
+            uint64_t ready = contiguous_size(state.segments);
+            if (ready == hashed) {
+                std::this_thread::sleep_for(kHashPollInterval);
+                continue;
+            }
+
+            size_t length = static_cast<size_t>(std::min<uint64_t>(buffer.size(), ready - hashed));
+            ssize_t read_size = pread(fd, buffer.data(), length, hashed);
+            if (read_size <= 0) {
+                hash_failed = true;
+                return;
+            }
+
+            hasher.update(buffer.data(), read_size);
+            hashed += read_size;
+        }
+    });
+
+    ProgressPhase progress("download", size);
+    for (const auto& segment : state.segments) {
+        progress.add_bytes(segment->done);
+    }
+
+    try {
+        parallel_for(state.segments.size(), state.segments.size(), [&](size_t i) {
+            download_segment(range_urls, fd, *state.segments[i], progress);
+        });
+    } catch (...) {
+        hash_aborted = true;
+        hash_feeder.join();
+        stop_saver();
+        persist();
+        close(fd);
+        throw;
+    }
+
+    stop_saver();
+    hash_feeder.join();
+
+    if (hash_failed) {
+        close(fd);
+        throw std::runtime_error("Failed to read back " + output_path.string());
+    }
+
+    if (fsync(fd) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to flush " + output_path.string());
+    }
+
+    close(fd);
+    fs::remove(state_path);
+
+    return hasher.finish();
+}
+
+void SegmentedDownloader::download_segment(const std::vector<std::string>& urls, int fd, Segment& segment,
+                                           ProgressPhase& progress) const {
+    TraceSpan span("download_segment", "download");
+    span.set_arg("offset", static_cast<double>(segment.start));
+    span.set_arg("resumed_bytes", static_cast<double>(segment.done));
+
+    std::string last_error;
+
+    int max_attempts = std::max<int>(kMaxAttempts, urls.size());
+
+    for (int attempt = 1; attempt <= max_attempts; attempt++) {
+        uint64_t offset = segment.start + segment.done;
+        if (offset >= segment.end) {
+            return;
+        }
+        
+        span.set_arg("attempt", attempt);
+
+        // every failed attempt moves the range on to the next mirror
+        const std::string& url = urls[(attempt - 1) % urls.size()];
+        if (attempt > 1) {
+            span.set_arg("url", url);
+        }
+
+        HttpRequest request{url, {"Range: bytes=" + std::to_string(offset) + "-" + std::to_string(segment.end - 1)}, 0};
+        request.stall_timeout = urls.size() > 1 ? kMirrorStallTimeout : kStallTimeout;
+        // only the HEAD showed range support, and only for the primary. a full
+        // 200 body would land at this segment's offset
+        request.expected_status = 206;
+        request.progress = &progress;
+
+        try {
+            HttpResponse response = client_.stream(request, [&](const char* data, size_t size) {
+                uint64_t position = segment.start + segment.done;
+                if (position + size > segment.end) {
+                    throw std::runtime_error("Server sent more data than requested");
+                }
+
+                while (size > 0) {
+                    ssize_t written = pwrite(fd, data, size, position);
+                    if (written < 0) {
+                        throw std::runtime_error("Failed to write downloaded data");
+                    }
+                    data += written;
+                    size -= written;
+                    position += written;
+                    segment.done += written;
+                }
+            });
+
+            if (response.status_code != 206) {
+                last_error = "HTTP error code: " + std::to_string(response.status_code);
+            } else if (segment.start + segment.done == segment.end) {
+                span.set_arg("bytes", static_cast<double>(segment.end - offset));
+                return;
+            } else {
+                last_error = "Connection closed early";
+            }
+        } catch (const std::exception& e) {
+            last_error = e.what();
+        }
+
+        // a mirror that hasn't been tried yet gets its turn right away
+        if (attempt % urls.size() == 0) {
+            std::this_thread::sleep_for(std::chrono::seconds(attempt / urls.size()));
+        }
+    }
+
+    throw std::runtime_error("Download failed: " + last_error);
+}
+
+std::string SegmentedDownloader::download_single(const std::vector<std::string>& urls, const fs::path& output_path) const {
+    std::string last_error;
+    ProgressPhase progress("download");
+
+    // without ranges a failed mirror means starting over on the next one
+    for (const auto& url : urls) {
+        FILE* file = fopen(output_path.string().c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("Failed to open file for writing: " + output_path.string());
+        }
+
+        HttpRequest request{url, {}, 0};
+        request.stall_timeout = urls.size() > 1 ? kMirrorStallTimeout : kStallTimeout;
+        request.progress = &progress;
+
+        Sha256Pipeline hasher;
+        HttpResponse response;
+        bool write_failed = false;
+        try {
+            response = client_.stream(request, [&](const char* data, size_t size) {
+                if (fwrite(data, 1, size, file) != size) {
+                    write_failed = true;
+                    throw std::runtime_error("Failed to write to " + output_path.string());
+                }
+                hasher.update(data, size);
+            });
+        } catch (const std::exception& e) {
+            fclose(file);
+            fs::remove(output_path);
+            if (write_failed) {
+                throw std::runtime_error("Download failed: " + std::string(e.what()));
+            }
+            last_error = "Download failed: " + std::string(e.what());
+            continue;
+        }
+
+        fclose(file);
+
+        if (response.status_code != 200) {
+            fs::remove(output_path);
+            last_error = "HTTP error code: " + std::to_string(response.status_code);
+            continue;
+        }
+
+        return hasher.finish();
+    }
+
+    throw std::runtime_error(last_error);
+}
+
+bool SegmentedDownloader::load_state(const fs::path& state_path, DownloadState& state) const {
+    std::ifstream file(state_path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        fields >> key;
+
+        if (key == "url") {
+            std::getline(fields >> std::ws, state.url);
+        } else if (key == "etag") {
+            std::getline(fields >> std::ws, state.etag);
+        } else if (key == "size") {
+            fields >> state.size;
+        } else if (key == "segment") {
+            auto segment = std::make_unique<Segment>();
+            uint64_t done = 0;
+            if (!(fields >> segment->start >> segment->end >> done) || segment->start + done > segment->end) {
+                return false;
+            }
+            segment->done = done;
+            state.segments.push_back(std::move(segment));
+        }
+    }
+
+    return !state.segments.empty() && state.segments.back()->end == state.size;
+}
+
+void SegmentedDownloader::save_state(const fs::path& state_path, const DownloadState& state,
+                                     const std::vector<uint64_t>& done) const {
+    std::ostringstream contents;
+    contents << "url " << state.url << "\n";
+    contents << "etag " << state.etag << "\n";
+    contents << "size " << state.size << "\n";
+    for (size_t i = 0; i < state.segments.size(); i++) {
+        const Segment& segment = *state.segments[i];
+        contents << "segment " << segment.start << " " << segment.end << " " << done[i] << "\n";
+    }
+
+    // a state that can't be saved only costs the resume, the download goes on
+    write_file_atomically(state_path, contents.str());
+}
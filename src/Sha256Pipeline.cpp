@@ -0,0 +1,98 @@
+#include "Sha256Pipeline.hpp"
+#include <algorithm>
+#include <cstring>
+
+Sha256Pipeline::Sha256Pipeline() {
+    for (auto& slot : slots_) {
+        slot.data.resize(kSlotSize);
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+Sha256Pipeline::~Sha256Pipeline() {
+    // abandoned before finish(), the partial slot is dropped
+    if (thread_.joinable()) {
+        close(false);
+        thread_.join();
+    }
+}
+
+void Sha256Pipeline::update(const char* data, size_t size) {
+    while (size > 0) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+
+        // ring full, wait for the hasher to release the oldest slot
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        while (head - tail == kSlotCount) {
+            tail_.wait(tail, std::memory_order_acquire);
+            tail = tail_.load(std::memory_order_acquire);
+        }
+
+        Slot& slot = slots_[head % kSlotCount];
+        size_t take = std::min(size, kSlotSize - slot.size);
+        std::memcpy(slot.data.data() + slot.size, data, take);
+        slot.size += take;
+        data += take;
+        size -= take;
+
+        if (slot.size == kSlotSize) {
+            publish();
+        }
+    }
+}
+
+void Sha256Pipeline::publish() {
+    head_.fetch_add(1, std::memory_order_release);
+    head_.notify_one();
+}
+
+void Sha256Pipeline::close(bool flush) {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head & kClosed) {
+        return;
+    }
+
+    // a partly filled slot is handed over together with the close flag. with
+    // the ring full the slot at head is still the hasher's, and there can't
+    // be a partial one
+    bool full = head - tail_.load(std::memory_order_acquire) == kSlotCount;
+    if (flush && !full && slots_[head % kSlotCount].size > 0) {
+        head++;
+    }
+    head_.store(head | kClosed, std::memory_order_release);
+    head_.notify_one();
+}
+
+std::string Sha256Pipeline::finish() {
+    if (thread_.joinable()) {
+        close(true);
+        thread_.join();
+    }
+    return digest_;
+}
+
+void Sha256Pipeline::run() {
+    uint64_t tail = 0;
+
+    while (true) {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t available = head & ~kClosed;
+
+        if (tail == available) {
+            if (head & kClosed) {
+                break;
+            }
+            head_.wait(head, std::memory_order_acquire);
+            continue;
+        }
+
+        Slot& slot = slots_[tail % kSlotCount];
+        sha_.update(slot.data.data(), slot.size);
+        slot.size = 0;
+
+        tail_.store(++tail, std::memory_order_release);
+        tail_.notify_one();
+    }
+
+    digest_ = sha_.hex_digest();
+}
@@ -1,12 +1,30 @@
 #include "SteamGameFinder.hpp"
-#include <fstream>
-#include <sstream>
+#include "VdfDocument.hpp"
+#include "CacheDir.hpp"
+#include "Parallel.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <map>
+#include <set>
 #include <unordered_set>
 
 SteamGameFinder::SteamGameFinder() {
+    TraceSpan span("steam_discovery", "steam");
+    
+    try {
+        index_ = std::make_unique<SteamLibraryIndex>(get_cache_dir() / "steam-index.json");
+        index_->load();
+    } catch (const std::exception&) {
+        // no usable cache dir, discovery just isn't remembered
+        index_.reset();
+    }
+    
     steam_root_ = find_steam_root();
-    library_folders_ = initialize_library_folders();
+    library_folders_ = load_library_folders();
+    
+    span.set_arg("libraries", static_cast<double>(library_folders_.size()));
 }
 
 std::optional<fs::path> SteamGameFinder::find_steam_root() const {
@@ -25,89 +43,30 @@ std::optional<fs::path> SteamGameFinder::find_steam_root() const {
     return std::nullopt;
 }
 
-std::unordered_map<std::string, std::string> SteamGameFinder::parse_vdf_file(const fs::path& file_path) const {
-    std::unordered_map<std::string, std::string> result;
-    
-    if (!fs::exists(file_path)) {
-        return result;
+std::vector<fs::path> SteamGameFinder::load_library_folders() const {
+    if (!steam_root_) {
+        return {};
     }
     
-    std::ifstream file(file_path);
-    if (!file.is_open()) {
-        return result;
-    }
+    TraceSpan span("load_library_folders", "steam");
+    int64_t mtime = SteamLibraryIndex::get_mtime(*steam_root_ / "steamapps" / "libraryfolders.vdf");
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string content = buffer.str();
+    if (index_) {
+        auto cached = index_->get_libraries(*steam_root_, mtime);
+        if (cached) {
+            span.set_arg("indexed", 1);
+            return *cached;
+        }
+    }
     
-    size_t pos = 0;
-    parse_vdf_recursive(content, pos, result);
+    std::vector<fs::path> folders = initialize_library_folders();
     
-    return result;
-}
-
-void SteamGameFinder::parse_vdf_recursive(const std::string& content, size_t& pos, 
-                                         std::unordered_map<std::string, std::string>& result, 
-                                         const std::string& prefix) const {
-    while (pos < content.length()) {
-        while (pos < content.length() && (std::isspace(content[pos]) || content[pos] == '\n' || content[pos] == '\r')) {
-            pos++;
-        }
-        
-        if (pos >= content.length()) break;
-        
-        if (pos + 1 < content.length() && content.substr(pos, 2) == "//") {
-            while (pos < content.length() && content[pos] != '\n') {
-                pos++;
-            }
-            continue;
-        }
-        
-        if (content[pos] == '}') {
-            pos++;
-            return;
-        }
-        
-        if (content[pos] == '{') {
-            pos++;
-            continue;
-        }
-        
-        if (content[pos] == '"') {
-            pos++;
-            
-            std::string key;
-            while (pos < content.length() && content[pos] != '"') {
-                key += content[pos];
-                pos++;
-            }
-            pos++;
-            
-            while (pos < content.length() && std::isspace(content[pos])) {
-                pos++;
-            }
-            
-            if (pos < content.length() && content[pos] == '"') {
-                pos++;
-                std::string value;
-                while (pos < content.length() && content[pos] != '"') {
-                    value += content[pos];
-                    pos++;
-                }
-                pos++;
-                
-                std::string full_key = prefix.empty() ? key : prefix + "." + key;
-                result[full_key] = value;
-            } else if (pos < content.length() && content[pos] == '{') {
-                pos++;
-                std::string new_prefix = prefix.empty() ? key : prefix + "." + key;
-                parse_vdf_recursive(content, pos, result, new_prefix);
-            }
-        } else {
-            pos++;
-        }
+    if (index_) {
+        index_->set_libraries(*steam_root_, mtime, folders);
+        index_->save();
     }
+    
+    return folders;
 }
 
 std::vector<fs::path> SteamGameFinder::initialize_library_folders() const {
@@ -118,20 +77,24 @@ std::vector<fs::path> SteamGameFinder::initialize_library_folders() const {
     std::vector<fs::path> folders = { *steam_root_ / "steamapps" };
     
     fs::path library_file = *steam_root_ / "steamapps" / "libraryfolders.vdf";
-    if (fs::exists(library_file)) {
-        auto data = parse_vdf_file(library_file);
-        
-        for (const auto& [key, value] : data) {
-            if (key.find("libraryfolders.") == 0 && key.find(".path") != std::string::npos) {
-                fs::path path = fs::path(value) / "steamapps";
-                if (fs::exists(path)) {
-                    folders.push_back(path);
-                }
-            } else if (key.find(".path") != std::string::npos) {
+    auto library_data = VdfDocument::load(library_file);
+    const VdfDocument::Node* root = library_data ? library_data->find_node("libraryfolders") : nullptr;
+    
+    if (root) {
+        for (auto entry = library_data->first_child(*root); entry; entry = library_data->next_sibling(*entry)) {
+            std::optional<std::string_view> value;
+            
+            if (entry->is_block) {
+                value = library_data->find("path", entry);
+            } else if (!entry->key.empty() && std::all_of(entry->key.begin(), entry->key.end(), ::isdigit)) {
 
                 // legacy format
 
-                fs::path path = fs::path(value) / "steamapps";
+                value = entry->value;
+            }
+            
+            if (value) {
+                fs::path path = fs::path(VdfDocument::unescape(*value)) / "steamapps";
                 if (fs::exists(path)) {
                     folders.push_back(path);
                 }
@@ -155,17 +118,42 @@ std::vector<fs::path> SteamGameFinder::initialize_library_folders() const {
 }
 
 std::optional<std::pair<fs::path, fs::path>> SteamGameFinder::find_game_by_appid(const std::string& app_id) const {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    std::optional<IndexedApp> indexed = index_ ? index_->get_app(app_id) : std::nullopt;
+    
+    // an unchanged appmanifest means the indexed installdir is still right
+    if (indexed && !indexed->installdir.empty()) {
+        fs::path acf_file = indexed->library_path / ("appmanifest_" + app_id + ".acf");
+        
+        if (SteamLibraryIndex::get_mtime(acf_file) == indexed->manifest_mtime) {
+            fs::path game_path = indexed->library_path / "common" / indexed->installdir;
+            
+            if (fs::exists(game_path)) {
+                return std::make_pair(game_path, indexed->library_path);
+            }
+        }
+    }
+    
     for (const auto& library_path : library_folders_) {
         fs::path acf_file = library_path / ("appmanifest_" + app_id + ".acf");
         
-        if (fs::exists(acf_file)) {
-            auto acf_data = parse_vdf_file(acf_file);
-            
-            auto it = acf_data.find("AppState.installdir");
-            if (it != acf_data.end()) {
-                fs::path game_path = library_path / "common" / it->second;
+        // a missing manifest just fails to map, no separate exists() check
+        auto acf_data = VdfDocument::load(acf_file, {"AppState.installdir"});
+        if (acf_data) {
+            auto installdir = acf_data->find("AppState.installdir");
+            if (installdir) {
+                fs::path game_path = library_path / "common" / VdfDocument::unescape(*installdir);
                 
                 if (fs::exists(game_path)) {
+                    if (index_) {
+                        IndexedApp app = indexed.value_or(IndexedApp{});
+                        app.library_path = library_path;
+                        app.installdir = VdfDocument::unescape(*installdir);
+                        app.manifest_mtime = SteamLibraryIndex::get_mtime(acf_file);
+                        index_->set_app(app_id, app);
+                        index_->save();
+                    }
+                    
                     return std::make_pair(game_path, library_path);
                 }
             }
@@ -177,24 +165,45 @@ std::optional<std::pair<fs::path, fs::path>> SteamGameFinder::find_game_by_appid
 
 std::optional<fs::path> SteamGameFinder::find_proton_prefix(const std::string& app_id, 
                                                            const std::optional<fs::path>& library_path) const {
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    std::optional<IndexedApp> indexed = index_ ? index_->get_app(app_id) : std::nullopt;
+    
+    std::optional<fs::path> result;
+    
+    // a prefix next to the game beats the indexed one, which may still be in
+    // the library the game was moved out of
     if (library_path) {
         fs::path compatdata_path = *library_path / "compatdata" / app_id / "pfx";
         if (fs::exists(compatdata_path)) {
-            return compatdata_path;
+            result = compatdata_path;
         }
     }
     
-    for (const auto& lib_path : library_folders_) {
-        fs::path compatdata_path = lib_path / "compatdata" / app_id / "pfx";
+    if (!result && indexed && indexed->proton_prefix && fs::exists(*indexed->proton_prefix)) {
+        return indexed->proton_prefix;
+    }
+    
+    for (size_t i = 0; !result && i < library_folders_.size(); i++) {
+        fs::path compatdata_path = library_folders_[i] / "compatdata" / app_id / "pfx";
         if (fs::exists(compatdata_path)) {
-            return compatdata_path;
+            result = compatdata_path;
         }
     }
     
-    return std::nullopt;
+    if (result && index_ && (!indexed || indexed->proton_prefix != result)) {
+        IndexedApp app = indexed.value_or(IndexedApp{});
+        app.proton_prefix = result;
+        index_->set_app(app_id, app);
+        index_->save();
+    }
+    
+    return result;
 }
 
 GameInfo SteamGameFinder::get_game_info(const std::string& app_id) const {
+    TraceSpan span("find_game", "steam");
+    span.set_arg("app_id", app_id);
+    
     GameInfo result;
     result.app_id = app_id;
     
@@ -211,4 +220,133 @@ GameInfo SteamGameFinder::get_game_info(const std::string& app_id) const {
     }
     
     return result;
-}
\ No newline at end of file
+}
+
+std::vector<GameInfo> SteamGameFinder::get_games_info(const std::vector<std::string>& app_ids) const {
+    TraceSpan span("scan_libraries", "steam");
+    span.set_arg("requested", static_cast<double>(app_ids.size()));
+    
+    struct LibraryScan {
+        // app id -> installdir, manifest mtime
+        std::map<std::string, std::pair<std::string, int64_t>> games;
+        std::unordered_set<std::string> prefixes;
+    };
+    
+    const std::string manifest_prefix = "appmanifest_";
+    const std::string manifest_suffix = ".acf";
+    
+    std::unordered_set<std::string> wanted(app_ids.begin(), app_ids.end());
+    bool want_all = app_ids.empty();
+    
+    std::vector<LibraryScan> scans(library_folders_.size());
+    
+    // libraries are usually separate drives, so they are scanned side by side
+    parallel_for(library_folders_.size(), library_folders_.size(), [&](size_t i) {
+        const fs::path& library_path = library_folders_[i];
+        LibraryScan& scan = scans[i];
+        std::error_code ec;
+        
+        TraceSpan library_span("scan_library", "steam");
+        library_span.set_arg("path", library_path.string());
+        
+        for (const auto& entry : fs::directory_iterator(library_path, ec)) {
+            std::string name = entry.path().filename().string();
+            
+            if (name.size() <= manifest_prefix.size() + manifest_suffix.size() ||
+                name.compare(0, manifest_prefix.size(), manifest_prefix) != 0 ||
+                name.compare(name.size() - manifest_suffix.size(), manifest_suffix.size(), manifest_suffix) != 0) {
+                continue;
+            }
+            
+            std::string app_id = name.substr(manifest_prefix.size(),
+                                             name.size() - manifest_prefix.size() - manifest_suffix.size());
+            if (!want_all && !wanted.count(app_id)) {
+                continue;
+            }
+            
+            auto acf_data = VdfDocument::load(entry.path(), {"AppState.installdir"});
+            auto installdir = acf_data ? acf_data->find("AppState.installdir") : std::nullopt;
+            if (!installdir) {
+                continue;
+            }
+            
+            std::string installdir_str = VdfDocument::unescape(*installdir);
+            if (fs::exists(library_path / "common" / installdir_str)) {
+                scan.games[app_id] = {installdir_str, SteamLibraryIndex::get_mtime(entry.path())};
+            }
+        }
+        
+        for (const auto& entry : fs::directory_iterator(library_path / "compatdata", ec)) {
+            std::string app_id = entry.path().filename().string();
+            if ((want_all || wanted.count(app_id)) && fs::exists(entry.path() / "pfx")) {
+                scan.prefixes.insert(app_id);
+            }
+        }
+    });
+    
+    std::vector<std::string> ids = app_ids;
+    if (want_all) {
+        std::set<std::string> installed;
+        for (const auto& scan : scans) {
+            for (const auto& [app_id, game] : scan.games) {
+                installed.insert(app_id);
+            }
+        }
+        ids.assign(installed.begin(), installed.end());
+    }
+    
+    std::vector<GameInfo> results;
+    results.reserve(ids.size());
+    
+    std::lock_guard<std::mutex> lock(index_mutex_);
+    
+    for (const auto& app_id : ids) {
+        GameInfo info;
+        info.app_id = app_id;
+        
+        // same precedence as the single lookups: first library wins, and a
+        // prefix next to the game beats one in another library
+        std::optional<size_t> game_library;
+        for (size_t i = 0; i < scans.size() && !game_library; i++) {
+            if (scans[i].games.count(app_id)) {
+                game_library = i;
+            }
+        }
+        
+        if (game_library) {
+            const auto& [installdir, mtime] = scans[*game_library].games.at(app_id);
+            info.library_path = library_folders_[*game_library];
+            info.game_path = *info.library_path / "common" / installdir;
+            info.found = true;
+            
+            if (scans[*game_library].prefixes.count(app_id)) {
+                info.proton_prefix = *info.library_path / "compatdata" / app_id / "pfx";
+            }
+        }
+        
+        for (size_t i = 0; i < scans.size() && !info.proton_prefix; i++) {
+            if (scans[i].prefixes.count(app_id)) {
+                info.proton_prefix = library_folders_[i] / "compatdata" / app_id / "pfx";
+            }
+        }
+        
+        if (index_ && (info.found || info.proton_prefix)) {
+            IndexedApp app = index_->get_app(app_id).value_or(IndexedApp{});
+            if (info.found) {
+                app.library_path = *info.library_path;
+                app.installdir = scans[*game_library].games.at(app_id).first;
+                app.manifest_mtime = scans[*game_library].games.at(app_id).second;
+            }
+            app.proton_prefix = info.proton_prefix;
+            index_->set_app(app_id, app);
+        }
+        
+        results.push_back(info);
+    }
+    
+    if (index_) {
+        index_->save();
+    }
+    
+    return results;
+}
@@ -0,0 +1,125 @@
+#include "SteamLibraryIndex.hpp"
+#include "CacheDir.hpp"
+#include <json/json.h>
+#include <fstream>
+#include <sstream>
+
+static constexpr int kIndexVersion = 1;
+
+SteamLibraryIndex::SteamLibraryIndex(fs::path file_path) : file_path_(std::move(file_path)) {}
+
+void SteamLibraryIndex::load() {
+    std::ifstream file(file_path_);
+    if (!file.is_open()) {
+        return;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+
+    Json::Value root;
+    Json::Reader reader;
+
+    if (!reader.parse(buffer.str(), root) || !root.isObject() || root["version"].asInt() != kIndexVersion) {
+        return;
+    }
+
+    steam_root_ = root["steam_root"].asString();
+    libraryfolders_mtime_ = root["libraryfolders_mtime"].asInt64();
+
+    libraries_.clear();
+    for (const auto& library : root["libraries"]) {
+        libraries_.push_back(library.asString());
+    }
+
+    apps_.clear();
+    const Json::Value& apps = root["apps"];
+    for (const auto& app_id : apps.getMemberNames()) {
+        const Json::Value& entry = apps[app_id];
+
+        IndexedApp app;
+        app.library_path = entry["library"].asString();
+        app.installdir = entry["installdir"].asString();
+        app.manifest_mtime = entry["manifest_mtime"].asInt64();
+        if (!entry["proton_prefix"].asString().empty()) {
+            app.proton_prefix = entry["proton_prefix"].asString();
+        }
+        apps_[app_id] = app;
+    }
+}
+
+bool SteamLibraryIndex::save() {
+    if (!dirty_) {
+        return true;
+    }
+
+    Json::Value root;
+    root["version"] = kIndexVersion;
+    root["steam_root"] = steam_root_.string();
+    root["libraryfolders_mtime"] = Json::Int64(libraryfolders_mtime_);
+
+    root["libraries"] = Json::Value(Json::arrayValue);
+    for (const auto& library : libraries_) {
+        root["libraries"].append(library.string());
+    }
+
+    root["apps"] = Json::Value(Json::objectValue);
+    for (const auto& [app_id, app] : apps_) {
+        Json::Value entry;
+        entry["library"] = app.library_path.string();
+        entry["installdir"] = app.installdir;
+        entry["manifest_mtime"] = Json::Int64(app.manifest_mtime);
+        entry["proton_prefix"] = app.proton_prefix ? app.proton_prefix->string() : "";
+        root["apps"][app_id] = entry;
+    }
+
+    Json::StreamWriterBuilder builder;
+    if (!write_file_atomically(file_path_, Json::writeString(builder, root))) {
+        return false;
+    }
+
+    dirty_ = false;
+    return true;
+}
+
+std::optional<std::vector<fs::path>> SteamLibraryIndex::get_libraries(const fs::path& steam_root,
+                                                                      int64_t libraryfolders_mtime) const {
+    if (libraries_.empty() || steam_root_ != steam_root || libraryfolders_mtime_ != libraryfolders_mtime) {
+        return std::nullopt;
+    }
+    return libraries_;
+}
+
+void SteamLibraryIndex::set_libraries(const fs::path& steam_root, int64_t libraryfolders_mtime,
+                                      const std::vector<fs::path>& libraries) {
+    if (steam_root_ != steam_root) {
+        apps_.clear();
+    }
+
+    steam_root_ = steam_root;
+    libraryfolders_mtime_ = libraryfolders_mtime;
+    libraries_ = libraries;
+    dirty_ = true;
+}
+
+std::optional<IndexedApp> SteamLibraryIndex::get_app(const std::string& app_id) const {
+    auto it = apps_.find(app_id);
+    if (it == apps_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void SteamLibraryIndex::set_app(const std::string& app_id, const IndexedApp& app) {
+    apps_[app_id] = app;
+    dirty_ = true;
+}
+
+int64_t SteamLibraryIndex::get_mtime(const fs::path& path) {
+    std::error_code ec;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+}
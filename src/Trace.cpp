@@ -0,0 +1,149 @@
+#include "Trace.hpp"
+#include <json/json.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    int64_t start_us;
+    int64_t duration_us;
+    std::vector<TraceArg> args;
+};
+
+// each thread appends to its own buffer, the lock is only contended while
+// the trace is being written
+struct ThreadBuffer {
+    std::mutex mutex;
+    long tid = 0;
+    std::vector<TraceEvent> events;
+};
+
+static std::atomic<bool> g_tracing_enabled{false};
+static std::mutex g_buffers_mutex;
+// buffers outlive their threads so spans from finished workers are kept
+static std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+
+static const std::chrono::steady_clock::time_point g_trace_epoch = std::chrono::steady_clock::now();
+
+static int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - g_trace_epoch).count();
+}
+
+static ThreadBuffer& get_thread_buffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto created = std::make_shared<ThreadBuffer>();
+        created->tid = syscall(SYS_gettid);
+
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        g_buffers.push_back(created);
+        return created;
+    }();
+    return *buffer;
+}
+
+void enable_tracing() {
+    g_tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+bool tracing_enabled() {
+    return g_tracing_enabled.load(std::memory_order_relaxed);
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category)
+    : active_(tracing_enabled()), name_(name), category_(category) {
+    if (active_) {
+        start_us_ = now_us();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (!active_) {
+        return;
+    }
+
+    int64_t end_us = now_us();
+    ThreadBuffer& buffer = get_thread_buffer();
+
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back({name_, category_, start_us_, end_us - start_us_, std::move(args_)});
+}
+
+void TraceSpan::set_arg(const char* key, double value) {
+    if (active_) {
+        args_.push_back({key, {}, value, false});
+    }
+}
+
+void TraceSpan::set_arg(const char* key, std::string value) {
+    if (active_) {
+        args_.push_back({key, std::move(value), 0, true});
+    }
+}
+
+void write_trace(const fs::path& path) {
+    Json::Value root;
+    Json::Value& events = root["traceEvents"];
+    events = Json::Value(Json::arrayValue);
+    root["displayTimeUnit"] = "ms";
+
+    long pid = getpid();
+
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(g_buffers_mutex);
+        buffers = g_buffers;
+    }
+
+    for (const auto& buffer : buffers) {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+
+        for (const auto& event : buffer->events) {
+            Json::Value entry;
+            entry["name"] = event.name;
+            entry["cat"] = event.category;
+            entry["ph"] = "X";
+            entry["ts"] = static_cast<Json::Int64>(event.start_us);
+            entry["dur"] = static_cast<Json::Int64>(event.duration_us);
+            entry["pid"] = static_cast<Json::Int64>(pid);
+            entry["tid"] = static_cast<Json::Int64>(buffer->tid);
+
+            for (const auto& arg : event.args) {
+                entry["args"][arg.key] = arg.is_text ? Json::Value(arg.text) : Json::Value(arg.number);
+            }
+
+            events.append(entry);
+        }
+    }
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"] = "";
+
+    std::ofstream file(path, std::ios::trunc);
+    file << Json::writeString(writer, root) << std::endl;
+
+    if (!file) {
+        throw std::runtime_error("Failed to write trace file: " + path.string());
+    }
+}
+
+TraceSession::TraceSession(fs::path path) : path_(std::move(path)) {
+    enable_tracing();
+}
+
+TraceSession::~TraceSession() {
+    try {
+        write_trace(path_);
+        std::cout << "Trace written to " << path_.string() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,230 @@
+#include "VdfDocument.hpp"
+#include <algorithm>
+#include <cctype>
+
+static bool keys_equal(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<std::string_view> split_path(std::string_view path) {
+    std::vector<std::string_view> segments;
+
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t dot = path.find('.', start);
+        if (dot == std::string_view::npos) {
+            dot = path.size();
+        }
+        segments.push_back(path.substr(start, dot - start));
+        start = dot + 1;
+    }
+    return segments;
+}
+
+std::optional<VdfDocument> VdfDocument::load(const fs::path& path, const std::vector<std::string_view>& stop_after) {
+    std::optional<MappedFile> file = MappedFile::open(path);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    VdfDocument document;
+    document.file_ = std::move(file);
+    document.parse_content(document.file_->view(), stop_after);
+    return document;
+}
+
+VdfDocument VdfDocument::parse(std::string_view content, const std::vector<std::string_view>& stop_after) {
+    VdfDocument document;
+    document.parse_content(content, stop_after);
+    return document;
+}
+
+void VdfDocument::parse_content(std::string_view content, const std::vector<std::string_view>& stop_after) {
+    struct Level {
+        uint32_t node;
+        uint32_t last_child;
+    };
+
+    std::vector<std::vector<std::string_view>> targets;
+    for (auto path : stop_after) {
+        targets.push_back(split_path(path));
+    }
+    std::vector<bool> found(targets.size(), false);
+    size_t remaining_targets = targets.size();
+
+    nodes_.clear();
+    nodes_.reserve(content.size() / 32 + 1);
+    nodes_.push_back({});
+    nodes_[0].is_block = true;
+
+    std::vector<Level> stack = {{0, kNone}};
+    std::vector<std::string_view> key_path;
+    std::optional<std::string_view> pending_key;
+
+    auto append = [&](Node node) -> uint32_t {
+        uint32_t index = static_cast<uint32_t>(nodes_.size());
+        Level& level = stack.back();
+
+        nodes_.push_back(node);
+        if (level.last_child == kNone) {
+            nodes_[level.node].first_child = index;
+        } else {
+            nodes_[level.last_child].next_sibling = index;
+        }
+        level.last_child = index;
+        return index;
+    };
+
+    auto matches_target = [&](const std::vector<std::string_view>& target, std::string_view key) {
+        if (target.size() != key_path.size() + 1 || !keys_equal(target.back(), key)) {
+            return false;
+        }
+        for (size_t i = 0; i < key_path.size(); i++) {
+            if (!keys_equal(target[i], key_path[i])) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    size_t pos = 0;
+    const size_t length = content.size();
+
+    while (pos < length) {
+        char c = content[pos];
+
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            pos++;
+            continue;
+        }
+
+        if (c == '/' && pos + 1 < length && content[pos + 1] == '/') {
+            size_t newline = content.find('\n', pos);
+            pos = newline == std::string_view::npos ? length : newline + 1;
+            continue;
+        }
+
+        if (c == '{') {
+            pos++;
+            uint32_t index = append({pending_key.value_or(std::string_view()), {}, kNone, kNone, true});
+            key_path.push_back(pending_key.value_or(std::string_view()));
+            stack.push_back({index, kNone});
+            pending_key.reset();
+            continue;
+        }
+
+        if (c == '}') {
+            pos++;
+            if (stack.size() > 1) {
+                stack.pop_back();
+                key_path.pop_back();
+            }
+            pending_key.reset();
+            continue;
+        }
+
+        // platform conditionals like [$WIN32] are ignored
+        if (c == '[') {
+            size_t close = content.find(']', pos);
+            pos = close == std::string_view::npos ? length : close + 1;
+            continue;
+        }
+
+        std::string_view token;
+        if (c == '"') {
+            size_t start = ++pos;
+            while (pos < length && content[pos] != '"') {
+                pos += content[pos] == '\\' ? 2 : 1;
+            }
+            pos = std::min(pos, length);
+            token = content.substr(start, pos - start);
+            pos++;
+        } else {
+            size_t start = pos;
+            while (pos < length && !std::isspace(static_cast<unsigned char>(content[pos])) &&
+                   content[pos] != '{' && content[pos] != '}' && content[pos] != '"') {
+                pos++;
+            }
+            token = content.substr(start, pos - start);
+        }
+
+        if (!pending_key) {
+            pending_key = token;
+            continue;
+        }
+
+        append({*pending_key, token, kNone, kNone, false});
+
+        if (remaining_targets > 0) {
+            for (size_t i = 0; i < targets.size(); i++) {
+                if (!found[i] && matches_target(targets[i], *pending_key)) {
+                    found[i] = true;
+                    remaining_targets--;
+                }
+            }
+            if (remaining_targets == 0) {
+                return;
+            }
+        }
+
+        pending_key.reset();
+    }
+}
+
+const VdfDocument::Node* VdfDocument::find_node(std::string_view path, const Node* from) const {
+    const Node* node = from ? from : &nodes_[0];
+
+    for (auto segment : split_path(path)) {
+        const Node* child = first_child(*node);
+        while (child && !keys_equal(child->key, segment)) {
+            child = next_sibling(*child);
+        }
+
+        if (!child) {
+            return nullptr;
+        }
+        node = child;
+    }
+
+    return node;
+}
+
+std::optional<std::string_view> VdfDocument::find(std::string_view path, const Node* from) const {
+    const Node* node = find_node(path, from);
+    if (!node || node->is_block) {
+        return std::nullopt;
+    }
+    return node->value;
+}
+
+const VdfDocument::Node* VdfDocument::first_child(const Node& node) const {
+    return node.first_child == kNone ? nullptr : &nodes_[node.first_child];
+}
+
+const VdfDocument::Node* VdfDocument::next_sibling(const Node& node) const {
+    return node.next_sibling == kNone ? nullptr : &nodes_[node.next_sibling];
+}
+
+std::string VdfDocument::unescape(std::string_view value) {
+    std::string result;
+    result.reserve(value.size());
+
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '\\' && i + 1 < value.size()) {
+            char next = value[++i];
+            result += next == 'n' ? '\n' : next == 't' ? '\t' : next;
+        } else {
+            result += value[i];
+        }
+    }
+    return result;
+}
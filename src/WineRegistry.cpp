@@ -0,0 +1,282 @@
+#include "WineRegistry.hpp"
+#include "MappedFile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <fcntl.h>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+struct SectionInfo {
+    bool found = false;
+    // just past the last line that belongs to the section
+    size_t insert_pos = 0;
+};
+
+struct Splice {
+    size_t offset;
+    size_t length;
+    std::string text;
+};
+
+bool iequals(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+std::string format_value(const RegistryEdit& edit) {
+    return "\"" + edit.name + "\"=\"" + edit.value + "\"\n";
+}
+
+// "name"=... -> name, empty for anything that isn't a named value
+std::string_view value_name(std::string_view line) {
+    if (line.size() < 3 || line[0] != '"') {
+        return {};
+    }
+
+    size_t pos = 1;
+    while (pos < line.size() && line[pos] != '"') {
+        pos += line[pos] == '\\' ? 2 : 1;
+    }
+
+    if (pos + 1 >= line.size() || line[pos + 1] != '=') {
+        return {};
+    }
+    return line.substr(1, pos - 1);
+}
+
+void write_all(int fd, const char* data, size_t size, const fs::path& path) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            throw std::runtime_error("Failed to write to registry file: " + path.string());
+        }
+        data += written;
+        size -= written;
+    }
+}
+
+}
+
+WineRegistry::WineRegistry(fs::path reg_file_path) : reg_file_path_(std::move(reg_file_path)) {}
+
+std::optional<std::string> WineRegistry::get_value(const std::string& section, const std::string& name) const {
+    std::optional<MappedFile> file = MappedFile::open(reg_file_path_);
+    if (!file) {
+        return std::nullopt;
+    }
+
+    std::string_view content = file->view();
+    bool in_section = false;
+    size_t pos = 0;
+
+    while (pos < content.size()) {
+        size_t line_end = content.find('\n', pos);
+        line_end = line_end == std::string_view::npos ? content.size() : line_end;
+        std::string_view line = content.substr(pos, line_end - pos);
+        pos = line_end + 1;
+
+        if (!line.empty() && line[0] == '[') {
+            size_t close = line.find("] ");
+            if (close == std::string_view::npos) {
+                close = line.rfind(']');
+            }
+            in_section = iequals(section, line.substr(1, close == std::string_view::npos ? std::string_view::npos
+                                                                                          : close - 1));
+            continue;
+        }
+
+        if (!in_section || name.empty() || !iequals(value_name(line), name)) {
+            continue;
+        }
+
+        std::string_view data = line.substr(name.size() + 3);
+        if (!data.empty() && data.back() == '\r') {
+            data.remove_suffix(1);
+        }
+        if (data.size() >= 2 && data.front() == '"' && data.back() == '"') {
+            data = data.substr(1, data.size() - 2);
+        }
+        return std::string(data);
+    }
+
+    return std::nullopt;
+}
+
+void WineRegistry::apply(const std::vector<RegistryEdit>& edits) const {
+    std::optional<MappedFile> file = MappedFile::open(reg_file_path_);
+    if (!file) {
+        if (!fs::exists(reg_file_path_)) {
+            throw std::runtime_error("Registry file not found: " + reg_file_path_.string());
+        }
+        throw std::runtime_error("Failed to open registry file: " + reg_file_path_.string());
+    }
+
+    std::string_view content = file->view();
+    std::vector<SectionInfo> sections(edits.size());
+    // byte range of the value line (with continuations) each edit refers to
+    std::vector<std::pair<size_t, size_t>> value_lines(edits.size(), {std::string_view::npos, 0});
+
+    std::string_view current_section;
+    bool in_edited_section = false;
+    size_t pos = 0;
+
+    while (pos < content.size()) {
+        size_t line_start = pos;
+        size_t line_end = content.find('\n', pos);
+        line_end = line_end == std::string_view::npos ? content.size() : line_end;
+
+        // hex data continues on the next line after a trailing backslash
+        size_t end = line_end;
+        while (end > line_start && content[end - 1] == '\\' && end < content.size()) {
+            size_t next = content.find('\n', end + 1);
+            end = next == std::string_view::npos ? content.size() : next;
+        }
+
+        pos = end < content.size() ? end + 1 : end;
+        std::string_view line = content.substr(line_start, line_end - line_start);
+
+        if (!line.empty() && line[0] == '[') {
+            size_t close = line.find("] ");
+            if (close == std::string_view::npos) {
+                close = line.rfind(']');
+            }
+            current_section = line.substr(1, close == std::string_view::npos ? std::string_view::npos : close - 1);
+
+            in_edited_section = false;
+            for (size_t i = 0; i < edits.size(); i++) {
+                if (iequals(edits[i].section, current_section)) {
+                    sections[i].found = true;
+                    sections[i].insert_pos = pos;
+                    in_edited_section = true;
+                }
+            }
+            continue;
+        }
+
+        if (!in_edited_section || line.empty()) {
+            continue;
+        }
+
+        std::string_view name = value_name(line);
+
+        for (size_t i = 0; i < edits.size(); i++) {
+            if (!iequals(edits[i].section, current_section)) {
+                continue;
+            }
+
+            // the first blank line after a value ends the section in wine's layout
+            sections[i].insert_pos = pos;
+
+            if (!name.empty() && iequals(edits[i].name, name)) {
+                value_lines[i] = {line_start, pos - line_start};
+            }
+        }
+    }
+
+    std::vector<Splice> splices;
+    std::string appended;
+
+    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    std::stringstream hex_time;
+    hex_time << std::hex << now;
+
+    for (size_t i = 0; i < edits.size(); i++) {
+        const RegistryEdit& edit = edits[i];
+        bool exists = value_lines[i].first != std::string_view::npos;
+
+        if (edit.action == RegistryEdit::Action::Remove) {
+            if (exists) {
+                splices.push_back({value_lines[i].first, value_lines[i].second, ""});
+            }
+            continue;
+        }
+
+        if (exists) {
+            if (edit.action == RegistryEdit::Action::Set) {
+                splices.push_back({value_lines[i].first, value_lines[i].second, format_value(edit)});
+            }
+            continue;
+        }
+
+        if (sections[i].found) {
+            std::string text = format_value(edit);
+            // a last line without newline must not swallow the new value
+            if (sections[i].insert_pos == content.size() && !content.empty() && content.back() != '\n') {
+                text = "\n" + text;
+            }
+            splices.push_back({sections[i].insert_pos, 0, text});
+            continue;
+        }
+
+        // section doesn't exist, add it
+        std::string header = "[" + edit.section + "]";
+        size_t existing = appended.find(header);
+        if (existing == std::string::npos) {
+            appended += "\n\n" + header + " " + std::to_string(now) + "\n";
+            appended += "#time=" + hex_time.str() + "\n";
+            appended += format_value(edit);
+        } else {
+            size_t section_end = appended.find("\n\n", existing);
+            appended.insert(section_end == std::string::npos ? appended.size() : section_end + 1, format_value(edit));
+        }
+    }
+
+    if (splices.empty() && appended.empty()) {
+        return;
+    }
+
+    std::stable_sort(splices.begin(), splices.end(), [](const Splice& a, const Splice& b) {
+        return a.offset < b.offset;
+    });
+
+    struct stat st;
+    if (stat(reg_file_path_.c_str(), &st) != 0) {
+        throw std::runtime_error("Failed to stat registry file: " + reg_file_path_.string());
+    }
+
+    // unique per writer, batch targets in one prefix patch it from several threads
+    static std::atomic<size_t> counter{0};
+    fs::path temp_path = reg_file_path_;
+    temp_path += ".geode-tmp." + std::to_string(getpid()) + "." + std::to_string(counter++);
+
+    int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to write to registry file: " + reg_file_path_.string());
+    }
+
+    try {
+        size_t copied = 0;
+        for (const auto& splice : splices) {
+            write_all(fd, content.data() + copied, splice.offset - copied, reg_file_path_);
+            write_all(fd, splice.text.data(), splice.text.size(), reg_file_path_);
+            copied = splice.offset + splice.length;
+        }
+        write_all(fd, content.data() + copied, content.size() - copied, reg_file_path_);
+        write_all(fd, appended.data(), appended.size(), reg_file_path_);
+
+        if (fsync(fd) != 0) {
+            throw std::runtime_error("Failed to flush registry file: " + reg_file_path_.string());
+        }
+    } catch (...) {
+        close(fd);
+        fs::remove(temp_path);
+        throw;
+    }
+
+    close(fd);
+
+    std::error_code ec;
+    fs::rename(temp_path, reg_file_path_, ec);
+    if (ec) {
+        fs::remove(temp_path);
+        throw std::runtime_error("Failed to replace registry file: " + reg_file_path_.string());
+    }
+}
@@ -0,0 +1,332 @@
+#include "ZipFileExtractor.hpp"
+#include "ZipFormat.hpp"
+#include "BatchedFileWriter.hpp"
+#include "Checksum.hpp"
+#include "Parallel.hpp"
+#include "Progress.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef GEODE_HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+// one per worker, the decompressor state is reused for every entry
+class EntryInflater {
+public:
+    EntryInflater() {
+#ifdef GEODE_HAVE_LIBDEFLATE
+        decompressor_ = libdeflate_alloc_decompressor();
+        if (!decompressor_) {
+            throw std::runtime_error("Failed to initialize inflate");
+        }
+#else
+        if (inflateInit2(&stream_, -MAX_WBITS) != Z_OK) {
+            throw std::runtime_error("Failed to initialize inflate stream");
+        }
+#endif
+    }
+
+    ~EntryInflater() {
+#ifdef GEODE_HAVE_LIBDEFLATE
+        libdeflate_free_decompressor(decompressor_);
+#else
+        inflateEnd(&stream_);
+#endif
+    }
+
+    EntryInflater(const EntryInflater&) = delete;
+    EntryInflater& operator=(const EntryInflater&) = delete;
+
+    // the whole deflate stream into out, which it has to fill exactly
+    bool inflate_all(const char* in, size_t in_size, char* out, size_t out_size) {
+#ifdef GEODE_HAVE_LIBDEFLATE
+        return libdeflate_deflate_decompress(decompressor_, in, in_size, out, out_size, nullptr) ==
+               LIBDEFLATE_SUCCESS;
+#else
+        // zlib refuses a null output even when there is nothing to write
+        char empty;
+        inflateReset(&stream_);
+        stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in));
+        stream_.next_out = reinterpret_cast<Bytef*>(out ? out : &empty);
+
+        // avail_in/avail_out are 32 bits, bigger entries are fed in pieces
+        size_t in_left = in_size;
+        size_t out_left = out_size;
+        int ret = Z_OK;
+        while (ret == Z_OK) {
+            uInt in_chunk = static_cast<uInt>(std::min<size_t>(in_left, UINT_MAX));
+            uInt out_chunk = static_cast<uInt>(std::min<size_t>(out_left, UINT_MAX));
+            stream_.avail_in = in_chunk;
+            stream_.avail_out = out_chunk;
+
+            ret = inflate(&stream_, Z_FINISH);
+            in_left -= in_chunk - stream_.avail_in;
+            out_left -= out_chunk - stream_.avail_out;
+
+            if (ret == Z_BUF_ERROR && in_left > 0 && out_left > 0) {
+                ret = Z_OK;
+            }
+        }
+        return ret == Z_STREAM_END && out_left == 0;
+#endif
+    }
+
+private:
+#ifdef GEODE_HAVE_LIBDEFLATE
+    libdeflate_decompressor* decompressor_ = nullptr;
+#else
+    z_stream stream_{};
+#endif
+};
+
+const char* ZipFileExtractor::inflate_backend() {
+#ifdef GEODE_HAVE_LIBDEFLATE
+    return "libdeflate";
+#else
+    return "zlib";
+#endif
+}
+
+ZipFileExtractor::ZipFileExtractor(const fs::path& zip_path) : zip_path_(zip_path) {
+    mapping_ = MappedFile::open(zip_path_);
+    if (!mapping_) {
+        throw std::runtime_error("Failed to open zip file: " + zip_path_.string());
+    }
+
+    const char* data = mapping_->data();
+    uint64_t size = mapping_->size();
+
+    // the end record is the last signature whose comment runs exactly to the end
+    uint64_t end_record = UINT64_MAX;
+    uint64_t search_start = size > kEndOfCentralDirSize + 0xFFFF ? size - kEndOfCentralDirSize - 0xFFFF : 0;
+    for (uint64_t pos = size >= kEndOfCentralDirSize ? size - kEndOfCentralDirSize + 1 : 0; pos-- > search_start;) {
+        if (read_u32(data + pos) == kEndOfCentralDirSignature &&
+            pos + kEndOfCentralDirSize + read_u16(data + pos + 20) == size) {
+            end_record = pos;
+            break;
+        }
+    }
+    if (end_record == UINT64_MAX) {
+        throw std::runtime_error("Failed to find the end of the zip central directory");
+    }
+
+    uint64_t entry_count = read_u16(data + end_record + 10);
+    uint64_t directory_size = read_u32(data + end_record + 12);
+    uint64_t directory_offset = read_u32(data + end_record + 16);
+
+    if (end_record >= kZip64LocatorSize &&
+        read_u32(data + end_record - kZip64LocatorSize) == kZip64LocatorSignature) {
+        uint64_t record_offset = read_u64(data + end_record - kZip64LocatorSize + 8);
+        if (record_offset + kZip64EndOfCentralDirSize > end_record ||
+            read_u32(data + record_offset) != kZip64EndOfCentralDirSignature) {
+            throw std::runtime_error("Invalid zip64 end of central directory");
+        }
+
+        entry_count = read_u64(data + record_offset + 32);
+        directory_size = read_u64(data + record_offset + 40);
+        directory_offset = read_u64(data + record_offset + 48);
+    }
+
+    if (directory_offset + directory_size > end_record || directory_offset + directory_size < directory_offset) {
+        throw std::runtime_error("Invalid zip central directory offset");
+    }
+
+    parse_central_directory(directory_offset, directory_size, entry_count);
+
+    fd_ = open(zip_path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::runtime_error("Failed to open zip file: " + zip_path_.string());
+    }
+}
+
+ZipFileExtractor::~ZipFileExtractor() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void ZipFileExtractor::parse_central_directory(uint64_t directory_offset, uint64_t directory_size,
+                                               uint64_t entry_count) {
+    const char* data = mapping_->data();
+    const char* directory = data + directory_offset;
+    uint64_t pos = 0;
+
+    for (uint64_t i = 0; i < entry_count; i++) {
+        if (pos + kCentralHeaderSize > directory_size || read_u32(directory + pos) != kCentralHeaderSignature) {
+            throw std::runtime_error("Invalid zip central directory entry");
+        }
+
+        const char* header = directory + pos;
+        uint16_t flags = read_u16(header + 8);
+        uint16_t name_length = read_u16(header + 28);
+        uint16_t extra_length = read_u16(header + 30);
+        uint16_t comment_length = read_u16(header + 32);
+        if (pos + kCentralHeaderSize + name_length + extra_length + comment_length > directory_size) {
+            throw std::runtime_error("Invalid zip central directory entry");
+        }
+
+        ZipFileEntry entry;
+        entry.method = read_u16(header + 10);
+        entry.crc = read_u32(header + 16);
+        entry.compressed_size = read_u32(header + 20);
+        entry.uncompressed_size = read_u32(header + 24);
+        uint64_t local_offset = read_u32(header + 42);
+        entry.name.assign(header + kCentralHeaderSize, name_length);
+
+        // the zip64 field only holds the values that didn't fit, in this order
+        const char* extra = header + kCentralHeaderSize + name_length;
+        const char* extra_end = extra + extra_length;
+        while (extra + 4 <= extra_end) {
+            uint16_t header_id = read_u16(extra);
+            uint16_t data_size = read_u16(extra + 2);
+            const char* field = extra + 4;
+            const char* field_end = std::min(field + data_size, extra_end);
+
+            if (header_id == 0x0001) {
+                if (entry.uncompressed_size == 0xFFFFFFFF && field + 8 <= field_end) {
+                    entry.uncompressed_size = read_u64(field);
+                    field += 8;
+                }
+                if (entry.compressed_size == 0xFFFFFFFF && field + 8 <= field_end) {
+                    entry.compressed_size = read_u64(field);
+                    field += 8;
+                }
+                if (local_offset == 0xFFFFFFFF && field + 8 <= field_end) {
+                    local_offset = read_u64(field);
+                }
+            }
+            extra += 4 + data_size;
+        }
+
+        pos += kCentralHeaderSize + name_length + extra_length + comment_length;
+
+        if (entry.name.empty()) {
+            throw std::runtime_error("Zip entry has an empty name");
+        }
+        if (!is_contained_entry_name(entry.name)) {
+            throw std::runtime_error("Zip entry points outside the destination: " + entry.name);
+        }
+        if (entry.name.back() == '/') {
+            directories_.push_back(std::move(entry.name));
+            continue;
+        }
+        if (flags & 0x0001) {
+            throw std::runtime_error("Encrypted zip entries are not supported: " + entry.name);
+        }
+        if (entry.method != 0 && entry.method != Z_DEFLATED) {
+            throw std::runtime_error("Unsupported compression method in zip entry: " + entry.name);
+        }
+        if (entry.method == 0 && entry.compressed_size != entry.uncompressed_size) {
+            throw std::runtime_error("Invalid zip entry size: " + entry.name);
+        }
+
+        // the local header has its own name and extra field lengths
+        if (local_offset + kLocalHeaderSize > directory_offset ||
+            read_u32(data + local_offset) != kLocalHeaderSignature) {
+            throw std::runtime_error("Invalid zip local header: " + entry.name);
+        }
+        entry.data_offset = local_offset + kLocalHeaderSize + read_u16(data + local_offset + 26) +
+                            read_u16(data + local_offset + 28);
+        if (entry.data_offset + entry.compressed_size > directory_offset ||
+            entry.data_offset + entry.compressed_size < entry.data_offset) {
+            throw std::runtime_error("Zip entry lies outside the archive: " + entry.name);
+        }
+
+        uncompressed_size_ += entry.uncompressed_size;
+        entries_.push_back(std::move(entry));
+    }
+}
+
+void ZipFileExtractor::extract(const fs::path& destination, size_t thread_count) {
+    TraceSpan span("extract_entries", "extract");
+    span.set_arg("inflate", inflate_backend());
+
+    // parents of the files are created by the writer as it goes, only empty
+    // directories need to be made here
+    BatchedFileWriter writer(destination);
+    for (const auto& directory : directories_) {
+        writer.create_directory(directory);
+    }
+
+    // biggest entries first so the large DLLs don't end up as the tail
+    std::vector<const ZipFileEntry*> order;
+    order.reserve(entries_.size());
+    for (const auto& entry : entries_) {
+        order.push_back(&entry);
+    }
+    std::sort(order.begin(), order.end(), [](const ZipFileEntry* a, const ZipFileEntry* b) {
+        return a->compressed_size > b->compressed_size;
+    });
+
+    thread_count = resolve_thread_count(thread_count, order.size());
+    std::atomic<size_t> next_entry{0};
+    std::atomic<size_t> skipped{0};
+    std::atomic<size_t> copied{0};
+    ProgressPhase progress("extract", uncompressed_size_, entries_.size());
+
+    parallel_for(thread_count, thread_count, [&](size_t) {
+        TraceSpan worker_span("extract_worker", "extract");
+        size_t worker_entries = 0;
+        uint64_t worker_bytes = 0;
+        EntryInflater inflater;
+
+        try {
+            size_t i;
+            while ((i = next_entry.fetch_add(1)) < order.size()) {
+                const ZipFileEntry& entry = *order[i];
+                const char* compressed = mapping_->data() + entry.data_offset;
+                progress.add_bytes(entry.uncompressed_size);
+                progress.add_items();
+
+                if (skip_unchanged_ && file_matches_crc(destination / entry.name, entry.uncompressed_size, entry.crc)) {
+                    skipped++;
+                    continue;
+                }
+
+                // stored data is checked in the mapping, then copied file to file
+                if (entry.method == 0) {
+                    if (update_crc32(0, compressed, entry.compressed_size) != entry.crc) {
+                        throw std::runtime_error("CRC mismatch in zip entry: " + entry.name);
+                    }
+                    writer.copy_range(entry.name, fd_, entry.data_offset, entry.compressed_size);
+                    copied++;
+                } else {
+                    std::vector<char> contents(entry.uncompressed_size);
+                    if (!inflater.inflate_all(compressed, entry.compressed_size, contents.data(), contents.size())) {
+                        throw std::runtime_error("Failed to inflate zip entry: " + entry.name);
+                    }
+                    if (update_crc32(0, contents.data(), contents.size()) != entry.crc) {
+                        throw std::runtime_error("CRC mismatch in zip entry: " + entry.name);
+                    }
+                    writer.submit(entry.name, std::move(contents));
+                }
+
+                worker_entries++;
+                worker_bytes += entry.uncompressed_size;
+            }
+        } catch (...) {
+            next_entry = order.size();
+            throw;
+        }
+
+        worker_span.set_arg("entries", static_cast<double>(worker_entries));
+        worker_span.set_arg("bytes", static_cast<double>(worker_bytes));
+    });
+
+    writer.finish();
+    skipped_count_ = skipped;
+
+    span.set_arg("entries", static_cast<double>(entries_.size()));
+    span.set_arg("bytes", static_cast<double>(uncompressed_size_));
+    span.set_arg("threads", static_cast<double>(thread_count));
+    span.set_arg("stored", static_cast<double>(copied.load()));
+    span.set_arg("unchanged", static_cast<double>(skipped_count_));
+    span.set_arg("io_uring", writer.uses_io_uring() ? 1.0 : 0.0);
+}
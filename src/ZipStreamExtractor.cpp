@@ -0,0 +1,323 @@
+#include "ZipStreamExtractor.hpp"
+#include "ZipFormat.hpp"
+#include "Checksum.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+static constexpr size_t kOutputChunkSize = 64 * 1024;
+// the header's size is only trusted this far before the data proves it
+static constexpr uint64_t kMaxReserve = 256 * 1024 * 1024;
+
+ZipStreamExtractor::ZipStreamExtractor(const fs::path& destination, const fs::path& staging_dir)
+    : destination_(destination), staging_dir_(staging_dir),
+      writer_(staging_dir.empty() ? destination : staging_dir) {
+    if (inflateInit2(&inflate_stream_, -MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("Failed to initialize inflate stream");
+    }
+    inflate_ready_ = true;
+}
+
+ZipStreamExtractor::~ZipStreamExtractor() {
+    if (inflate_ready_) {
+        inflateEnd(&inflate_stream_);
+    }
+}
+
+void ZipStreamExtractor::feed(const char* data, size_t size) {
+    while (size > 0 && state_ != State::Done) {
+        size_t used = 0;
+
+        switch (state_) {
+            case State::Header:
+                used = consume_header(data, size);
+                break;
+            case State::Data:
+                used = consume_data(data, size);
+                break;
+            case State::Descriptor:
+                used = consume_descriptor(data, size);
+                break;
+            case State::Done:
+                break;
+        }
+
+        data += used;
+        size -= used;
+    }
+}
+
+void ZipStreamExtractor::finish() {
+    if (state_ != State::Done && !(state_ == State::Header && buffer_.empty())) {
+        throw std::runtime_error("Unexpected end of zip stream");
+    }
+    writer_.finish();
+}
+
+void ZipStreamExtractor::commit() {
+    if (staging_dir_.empty()) {
+        return;
+    }
+
+    for (const auto& name : directory_names_) {
+        fs::create_directories(destination_ / name);
+    }
+
+    // each rename replaces the installed file in one step
+    for (const auto& name : written_names_) {
+        fs::path target = destination_ / name;
+        fs::create_directories(target.parent_path());
+        fs::rename(staging_dir_ / name, target);
+    }
+
+    fs::remove_all(staging_dir_);
+}
+
+size_t ZipStreamExtractor::consume_header(const char* data, size_t size) {
+    // signature first, then the fixed header, then name + extra field
+    size_t needed = 4;
+    if (buffer_.size() >= kLocalHeaderSize) {
+        needed = kLocalHeaderSize + read_u16(buffer_, 26) + read_u16(buffer_, 28);
+    } else if (buffer_.size() >= 4) {
+        needed = kLocalHeaderSize;
+    }
+
+    size_t take = std::min(needed - buffer_.size(), size);
+    buffer_.append(data, take);
+
+    if (buffer_.size() < needed) {
+        return take;
+    }
+
+    if (needed == 4) {
+        uint32_t signature = read_u32(buffer_, 0);
+
+        if (signature == kCentralHeaderSignature || signature == kEndOfCentralDirSignature ||
+            signature == kZip64EndOfCentralDirSignature) {
+            // everything past the last local entry is the central directory
+            state_ = State::Done;
+        } else if (signature != kLocalHeaderSignature) {
+            throw std::runtime_error("Invalid zip local header signature");
+        }
+        return take;
+    }
+
+    if (needed == kLocalHeaderSize && read_u16(buffer_, 26) + read_u16(buffer_, 28) > 0) {
+        return take;
+    }
+
+    begin_entry();
+    return take;
+}
+
+void ZipStreamExtractor::begin_entry() {
+    uint16_t flags = read_u16(buffer_, 6);
+    method_ = read_u16(buffer_, 8);
+    expected_crc_ = read_u32(buffer_, 14);
+    uint64_t compressed_size = read_u32(buffer_, 18);
+    uint64_t uncompressed_size = read_u32(buffer_, 22);
+    uint16_t name_length = read_u16(buffer_, 26);
+    uint16_t extra_length = read_u16(buffer_, 28);
+
+    entry_name_ = buffer_.substr(kLocalHeaderSize, name_length);
+    has_descriptor_ = (flags & 0x0008) != 0;
+    zip64_ = false;
+    entry_size_ = 0;
+
+    if (entry_name_.empty()) {
+        throw std::runtime_error("Zip entry has an empty name");
+    }
+
+    if (!is_contained_entry_name(entry_name_)) {
+        throw std::runtime_error("Zip entry points outside the destination: " + entry_name_);
+    }
+
+    if (flags & 0x0001) {
+        throw std::runtime_error("Encrypted zip entries are not supported: " + entry_name_);
+    }
+
+    // zip64 extended information extra field
+    size_t extra_pos = kLocalHeaderSize + name_length;
+    size_t extra_end = extra_pos + extra_length;
+    while (extra_pos + 4 <= extra_end) {
+        uint16_t header_id = read_u16(buffer_, extra_pos);
+        uint16_t data_size = read_u16(buffer_, extra_pos + 2);
+
+        if (extra_pos + 4 + data_size > extra_end) {
+            throw std::runtime_error("Invalid extra field in zip entry: " + entry_name_);
+        }
+
+        if (header_id == 0x0001 && data_size >= 16) {
+            uncompressed_size = read_u64(buffer_, extra_pos + 4);
+            compressed_size = read_u64(buffer_, extra_pos + 4 + 8);
+            zip64_ = true;
+        }
+        extra_pos += 4 + data_size;
+    }
+
+    buffer_.clear();
+
+    if (method_ != 0 && method_ != Z_DEFLATED) {
+        throw std::runtime_error("Unsupported compression method in zip entry: " + entry_name_);
+    }
+
+    if (method_ == 0 && has_descriptor_) {
+        throw std::runtime_error("Stored zip entry without known size: " + entry_name_);
+    }
+
+    skip_data_ = false;
+    writing_ = false;
+    entry_data_.clear();
+
+    // some archivers store a deflated empty payload for directories, so
+    // they still go through the data states with nothing to write
+    if (entry_name_.back() == '/') {
+        writer_.create_directory(entry_name_);
+        directory_names_.push_back(entry_name_);
+    } else if (skip_unchanged_ && !has_descriptor_ &&
+               file_matches_crc(destination_ / entry_name_, uncompressed_size, expected_crc_)) {
+        // sizes are known up front, so the payload can be dropped without inflating it
+        skip_data_ = true;
+        entry_size_ = uncompressed_size;
+    } else {
+        writing_ = true;
+        if (!has_descriptor_) {
+            entry_data_.reserve(static_cast<size_t>(std::min<uint64_t>(uncompressed_size, kMaxReserve)));
+        }
+    }
+
+    crc_ = 0;
+    remaining_ = compressed_size;
+
+    if (method_ == Z_DEFLATED) {
+        inflateReset(&inflate_stream_);
+    }
+
+    state_ = State::Data;
+
+    if ((method_ == 0 || skip_data_) && remaining_ == 0) {
+        finish_entry(expected_crc_);
+    }
+}
+
+size_t ZipStreamExtractor::consume_data(const char* data, size_t size) {
+    if (skip_data_) {
+        size_t take = static_cast<size_t>(std::min<uint64_t>(remaining_, size));
+        remaining_ -= take;
+
+        if (remaining_ == 0) {
+            finish_entry(expected_crc_);
+        }
+        return take;
+    }
+
+    if (method_ == 0) {
+        size_t take = static_cast<size_t>(std::min<uint64_t>(remaining_, size));
+
+        if (writing_) {
+            entry_data_.insert(entry_data_.end(), data, data + take);
+        }
+        crc_ = update_crc32(crc_, data, take);
+        remaining_ -= take;
+
+        if (remaining_ == 0) {
+            finish_entry(expected_crc_);
+        }
+        return take;
+    }
+
+    unsigned char out[kOutputChunkSize];
+    size_t chunk = std::min<size_t>(size, UINT32_MAX);
+
+    inflate_stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    inflate_stream_.avail_in = static_cast<uInt>(chunk);
+
+    do {
+        inflate_stream_.next_out = out;
+        inflate_stream_.avail_out = sizeof(out);
+
+        int ret = inflate(&inflate_stream_, Z_NO_FLUSH);
+        if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            throw std::runtime_error("Failed to inflate zip entry: " + entry_name_);
+        }
+
+        size_t produced = sizeof(out) - inflate_stream_.avail_out;
+        if (writing_) {
+            entry_data_.insert(entry_data_.end(), out, out + produced);
+        }
+        crc_ = update_crc32(crc_, out, produced);
+
+        if (ret == Z_STREAM_END) {
+            size_t used = chunk - inflate_stream_.avail_in;
+            end_entry_data();
+            return used;
+        }
+
+        if (ret == Z_BUF_ERROR) {
+            break;
+        }
+    } while (inflate_stream_.avail_in > 0 || inflate_stream_.avail_out == 0);
+
+    return chunk - inflate_stream_.avail_in;
+}
+
+void ZipStreamExtractor::end_entry_data() {
+    if (has_descriptor_) {
+        state_ = State::Descriptor;
+        return;
+    }
+    finish_entry(expected_crc_);
+}
+
+size_t ZipStreamExtractor::consume_descriptor(const char* data, size_t size) {
+    // the descriptor signature is optional
+    size_t sizes_length = zip64_ ? 16 : 8;
+    size_t needed = 4;
+    if (buffer_.size() >= 4) {
+        needed = (read_u32(buffer_, 0) == kDataDescriptorSignature ? 4 : 0) + 4 + sizes_length;
+    }
+
+    size_t take = std::min(needed - buffer_.size(), size);
+    buffer_.append(data, take);
+
+    if (buffer_.size() < needed || needed == 4) {
+        return take;
+    }
+
+    size_t crc_offset = read_u32(buffer_, 0) == kDataDescriptorSignature ? 4 : 0;
+    uint32_t expected_crc = read_u32(buffer_, crc_offset);
+    buffer_.clear();
+
+    finish_entry(expected_crc);
+    return take;
+}
+
+void ZipStreamExtractor::finish_entry(uint32_t expected_crc) {
+    state_ = State::Header;
+
+    if (skip_data_) {
+        skipped_count_++;
+        progress_.add_bytes(entry_size_);
+        progress_.add_items();
+        file_names_.push_back(entry_name_);
+        return;
+    }
+
+    if (!writing_) {
+        return;
+    }
+    writing_ = false;
+
+    // a corrupt entry never reaches the disk
+    if (crc_ != expected_crc) {
+        throw std::runtime_error("CRC mismatch in zip entry: " + entry_name_);
+    }
+
+    progress_.add_bytes(entry_data_.size());
+    progress_.add_items();
+
+    file_names_.push_back(entry_name_);
+    written_names_.push_back(entry_name_);
+    writer_.submit(entry_name_, std::move(entry_data_));
+    entry_data_ = {};
+    extracted_count_++;
+}
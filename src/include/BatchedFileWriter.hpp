@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct io_uring;
+
+// writes whole files below a root directory off the caller's threads.
+// parent directories are created once and remembered, every file is
+// preallocated to its final size, and opens, writes and closes go to the
+// kernel in batches through io_uring relative to the root's directory fd.
+// without io_uring (not built in, or refused by the kernel) a small pool
+// of threads does the same with openat, fallocate and pwrite.
+class BatchedFileWriter {
+public:
+    explicit BatchedFileWriter(const fs::path& root);
+    ~BatchedFileWriter();
+
+    BatchedFileWriter(const BatchedFileWriter&) = delete;
+    BatchedFileWriter& operator=(const BatchedFileWriter&) = delete;
+
+    // queues root/relative_path with these contents, thread safe. blocks while
+    // too much data is waiting, throws once an earlier write has failed.
+    void submit(std::string relative_path, std::vector<char> contents);
+
+    // writes size bytes of source_fd starting at offset to root/relative_path
+    // on the calling thread, copied inside the kernel with copy_file_range
+    // where possible. thread safe, and it doesn't wait for queued files
+    void copy_range(const std::string& relative_path, int source_fd, uint64_t offset, uint64_t size);
+
+    void create_directory(const std::string& relative_path);
+
+    // waits until every submitted file is written and closed, rethrows the
+    // first error. nothing can be submitted afterwards.
+    void finish();
+
+    bool uses_io_uring() const { return ring_ != nullptr; }
+
+private:
+    struct PendingFile {
+        std::string path;
+        std::vector<char> contents;
+    };
+
+    // hands out up to max_files queued files, false once closed and drained
+    bool pop_files(std::vector<PendingFile>& files, size_t max_files);
+    void files_done(const std::vector<PendingFile>& files);
+    void record_error(std::exception_ptr error);
+    bool failed();
+
+    void ensure_directory(const std::string& relative_path);
+    void ensure_parent(const std::string& relative_path);
+
+    void run_pool_worker();
+    void write_with_pwrite(const PendingFile& file);
+
+    void run_io_uring();
+    void write_batch_io_uring(std::vector<PendingFile>& batch);
+
+    fs::path root_;
+    int root_fd_ = -1;
+    io_uring* ring_ = nullptr;
+
+    std::mutex queue_mutex_;
+    std::condition_variable queue_changed_;
+    std::deque<PendingFile> queue_;
+    size_t queued_bytes_ = 0;
+    bool closing_ = false;
+    std::exception_ptr error_;
+
+    std::mutex directories_mutex_;
+    std::unordered_set<std::string> directories_;
+
+    std::vector<std::thread> threads_;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// $XDG_CACHE_HOME/geode-installer, falling back to ~/.cache/geode-installer
+fs::path get_cache_dir();
+
+// writes contents to a temporary file next to path and renames it over
+// path, creating the parent directories. readers only ever see the old or
+// the new file. false on any error, with nothing left behind
+bool write_file_atomically(const fs::path& path, const std::string& contents);
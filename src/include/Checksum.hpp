@@ -0,0 +1,21 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// the zip CRC32 of data, continuing from crc (0 for the first chunk). uses
+// libdeflate's carry-less multiply kernel when built with it, zlib's otherwise
+uint32_t update_crc32(uint32_t crc, const void* data, size_t size);
+
+std::optional<uint32_t> crc32_of_file(const fs::path& path);
+
+// lowercase hex
+std::optional<std::string> sha256_of_file(const fs::path& path);
+
+// true when the file exists with exactly this size and CRC32, the size is
+// checked first so most mismatches never read the file
+bool file_matches_crc(const fs::path& path, uint64_t size, uint32_t crc);
@@ -1,39 +1,125 @@
 #pragma once
 
 #include "SteamGameFinder.hpp"
+#include "InstallerOptions.hpp"
+#include "HttpClient.hpp"
+#include "ReleaseStore.hpp"
+#include "InstallManifest.hpp"
 #include <string>
 #include <filesystem>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
 
 namespace fs = std::filesystem;
 
+struct InstallTarget {
+    fs::path prefix;
+    fs::path gd_path;
+};
+
+struct InstallResult {
+    InstallTarget target;
+    bool success = false;
+    std::string error;
+    std::chrono::milliseconds duration{0};
+};
+
 class GeodeInstaller {
 public:
-    GeodeInstaller();
+    explicit GeodeInstaller(InstallerOptions options = {});
     
     std::string get_latest_geode_tag() const;
     
     std::string get_download_url() const;
     
-    void unzip_to_destination(const std::string& zip_url, const fs::path& destination_dir) const;
+    // returns the release's files relative to destination_dir
+    std::vector<std::string> install_to_dir(const fs::path& destination_dir) const;
+    
+    // true when the override wasn't there before
+    bool patch_prefix_registry(const fs::path& reg_file_path) const;
     
-    void install_to_dir(const fs::path& destination_dir) const;
+    // the xinput1_4 override patch_prefix_registry() adds is in place
+    bool is_prefix_patched(const fs::path& reg_file_path) const;
     
-    void patch_prefix_registry(const fs::path& reg_file_path) const;
+    // the files that make Wine load Geode are in the game directory
+    bool is_loader_present(const fs::path& gd_path) const;
     
     void install_geode_to_wine(const fs::path& prefix, const fs::path& gd_path) const;
     
     void install_geode_to_steam() const;
+    
+    std::vector<InstallResult> install_geode_batch(const std::vector<InstallTarget>& targets) const;
+    
+    // records what an install put into gd_path, see InstallManifest. an
+    // override added by an earlier install stays recorded, an empty
+    // reg_file_path keeps the recorded user.reg and its edits
+    void write_install_manifest(const fs::path& gd_path, const std::vector<std::string>& files,
+                                const fs::path& reg_file_path, bool override_added) const;
+    
+    // both throw when gd_path has no install manifest
+    VerifyResult verify_install(const fs::path& gd_path) const;
+    
+    UninstallResult uninstall(const fs::path& gd_path) const;
+    
+    // returns the archive's files relative to destination
+    std::vector<std::string> extract_zip(const fs::path& zip_path, const fs::path& destination, size_t thread_count) const;
 
 private:
-    SteamGameFinder finder_;
+    InstallerOptions options_;
+    // created on first use, so installs that never touch Steam don't scan
+    // its libraries at startup
+    mutable std::once_flag finder_once_;
+    mutable std::unique_ptr<SteamGameFinder> finder_;
+    mutable HttpClient http_client_;
+    
+    mutable std::mutex tag_mutex_;
+    mutable std::optional<std::string> latest_tag_;
+    
+    const SteamGameFinder& get_finder() const;
+    
+    GameInfo find_steam_game() const;
+    
+    // downloads and extracts the release into a directory that may still be
+    // unknown when it starts, a failed future aborts the transfer
+    std::vector<std::string> install_to_deferred_dir(const std::shared_future<fs::path>& destination_dir) const;
+    
+    HttpResponse perform_http_request(const std::string& url, const std::vector<std::string>& headers = {}) const;
     
     std::string make_http_request(const std::string& url) const;
     
-    void download_file(const std::string& url, const fs::path& output_path) const;
+    std::string fetch_latest_geode_tag() const;
+    
+    // the release zip on every configured mirror, fastest first
+    std::vector<std::string> get_download_urls() const;
+    
+    // fetches only the entries of the release zip that differ from what is
+    // in destination, using range requests against the central directory
+    std::vector<std::string> update_changed_entries(const std::string& url, const fs::path& destination) const;
+    
+    // urls point at the same file, fastest first. returns the SHA-256 of the downloaded file
+    std::string download_file(const std::vector<std::string>& urls, const fs::path& output_path) const;
+    
+    std::optional<std::string> fetch_release_digest(const std::string& tag) const;
+    
+    std::future<std::optional<std::string>> request_release_digest() const;
+    
+    void verify_release_digest(std::future<std::optional<std::string>>& expected, const std::string& actual) const;
+    
+    std::vector<std::string> download_and_extract(const std::vector<std::string>& urls, const std::shared_future<fs::path>& destination) const;
+    
+    // for archives ZipFileExtractor turns down
+    std::vector<std::string> extract_zip_with_libzip(const fs::path& zip_path, const fs::path& destination, size_t thread_count) const;
+    
+    fs::path download_release_archive() const;
     
-    void extract_zip(const fs::path& zip_path, const fs::path& destination) const;
+    ReleaseStore open_store() const;
     
-    std::string get_current_timestamp() const;
+    // extracts the latest release into the store unless it's already there,
+    // returns its tag
+    std::string add_release_to_store(const ReleaseStore& store) const;
     
-    std::string get_hex_timestamp() const;
 };
\ No newline at end of file
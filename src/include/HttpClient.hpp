@@ -0,0 +1,77 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct HttpResponse {
+    long status_code = 0;
+    std::string body;
+    // url of the last response after following redirects
+    std::string effective_url;
+    // header names are lowercased
+    std::map<std::string, std::string> headers;
+};
+
+class ProgressPhase;
+
+// stall_timeout for long downloads, and for ones that have another mirror
+// to fall back on, where a stalled transfer is given up quickly
+inline constexpr long kStallTimeout = 30;
+inline constexpr long kMirrorStallTimeout = 5;
+
+struct HttpRequest {
+    std::string url;
+    std::vector<std::string> headers;
+    // total seconds, 0 = no limit
+    long timeout = 30;
+    // abort when slower than 1 KiB/s for this many seconds, 0 = off
+    long stall_timeout = 0;
+    bool head = false;
+    // streamed bodies must come with exactly this status, e.g. 206 when
+    // resuming. anything else aborts the transfer. 0 = any 2xx
+    long expected_status = 0;
+    // polled while the transfer runs, setting it aborts the request
+    const std::atomic<bool>* cancel = nullptr;
+    // received bytes are added to it as they arrive. a phase without a size
+    // yet takes this transfer's Content-Length
+    ProgressPhase* progress = nullptr;
+};
+
+// receives 2xx bodies as they arrive, may throw to abort the transfer
+using HttpDataCallback = std::function<void(const char* data, size_t size)>;
+
+// thread safe. easy handles are pooled so their connections stay alive
+// between requests, and every handle shares one DNS and TLS session cache.
+class HttpClient {
+public:
+    HttpClient();
+    ~HttpClient();
+
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    HttpResponse get(const HttpRequest& request);
+
+    // like get, but a successful body goes to on_data instead of the response
+    HttpResponse stream(const HttpRequest& request, const HttpDataCallback& on_data);
+
+private:
+    HttpResponse perform(const HttpRequest& request, const HttpDataCallback* on_data);
+
+    CURL* acquire_handle();
+    void release_handle(CURL* handle);
+
+    static void lock_share(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr);
+    static void unlock_share(CURL* handle, curl_lock_data data, void* userptr);
+
+    CURLSH* share_;
+    std::mutex share_mutexes_[CURL_LOCK_DATA_LAST];
+
+    std::mutex pool_mutex_;
+    std::vector<CURL*> idle_handles_;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "WineRegistry.hpp"
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct ManifestFile {
+    // relative to the game directory, '/' separated
+    std::string path;
+    uint64_t size = 0;
+    // st_mtim in nanoseconds when the manifest was written
+    int64_t mtime_ns = 0;
+    uint32_t crc = 0;
+};
+
+struct VerifyResult {
+    size_t checked = 0;
+    // files whose mtime had changed, so their contents were hashed
+    size_t hashed = 0;
+    std::vector<std::string> missing;
+    std::vector<std::string> modified;
+    // registry values the install added that are gone now
+    std::vector<std::string> missing_registry;
+
+    bool intact() const { return missing.empty() && modified.empty() && missing_registry.empty(); }
+};
+
+struct UninstallResult {
+    size_t removed = 0;
+    // already gone before the uninstall
+    size_t missing = 0;
+    size_t reverted_registry = 0;
+    // the recorded user.reg, so its prefix, empty when the install edited none
+    fs::path registry_file;
+};
+
+// what an install put into a game directory: every file with its size,
+// mtime and CRC32, the release tag, and the registry values it added.
+// kept as <gd_path>/.geode-installer.manifest in a small binary format, so
+// checking an install is a stat per file and never a download.
+struct InstallManifest {
+    std::string tag;
+    // the user.reg the registry edits went to, empty when none
+    fs::path registry_file;
+    // values the install added, all of them Set
+    std::vector<RegistryEdit> registry_edits;
+    std::vector<ManifestFile> files;
+
+    static fs::path path_in(const fs::path& gd_path);
+
+    // stats and hashes the given files below gd_path, thread_count 0 = one per core
+    static InstallManifest record(const fs::path& gd_path, const std::vector<std::string>& files,
+                                  size_t thread_count);
+
+    // nullopt when there is none, throws when it is damaged
+    static std::optional<InstallManifest> load(const fs::path& gd_path);
+
+    // write then rename, a manifest is only ever seen complete
+    void save(const fs::path& gd_path) const;
+
+    // a parallel stat of every file. only the ones whose size still matches
+    // but whose mtime doesn't are hashed
+    VerifyResult verify(const fs::path& gd_path, size_t thread_count) const;
+
+    // removes the recorded files and the directories they leave empty, and
+    // the registry values that still hold what the install wrote. the
+    // manifest itself goes last
+    UninstallResult uninstall(const fs::path& gd_path) const;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "GeodeInstaller.hpp"
+#include "SteamGameFinder.hpp"
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+
+namespace fs = std::filesystem;
+
+// keeps Geode installed in Steam's Geometry Dash. inotify watches the
+// steamapps directories (for the game's appmanifest), the game directory
+// and the Proton prefix (for user.reg). once events have been quiet for the
+// debounce period the install is checked and only what went missing,
+// Geode's files or the xinput1_4 override, is put back. in between the
+// process sleeps in poll().
+class InstallWatcher {
+public:
+    InstallWatcher(const GeodeInstaller& installer, const SteamGameFinder& finder,
+                   std::chrono::milliseconds debounce = std::chrono::seconds(3));
+    ~InstallWatcher();
+
+    InstallWatcher(const InstallWatcher&) = delete;
+    InstallWatcher& operator=(const InstallWatcher&) = delete;
+
+    // checks the install once, then blocks until stop()
+    void run();
+
+    // async-signal-safe
+    void stop();
+
+private:
+    struct Watch {
+        fs::path directory;
+        // only events for this entry matter, empty = any entry
+        std::string name;
+    };
+
+    // true when an event touched something the install depends on
+    bool read_events();
+
+    void update_watches(const GameInfo& info);
+
+    // every file the manifest recorded is there and unchanged. the registry
+    // is checked on its own
+    bool geode_files_intact(const fs::path& gd_path) const;
+
+    // false when the repair failed and should be retried later
+    bool check_and_repair();
+
+    const GeodeInstaller& installer_;
+    const SteamGameFinder& finder_;
+    std::chrono::milliseconds debounce_;
+
+    int inotify_fd_ = -1;
+    int stop_fd_ = -1;
+    std::map<int, Watch> watches_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct InstallerOptions {
+    // extract entries while the release zip is still downloading instead of
+    // writing it to disk first
+    bool stream_extract = true;
+
+    // worker threads used by extract_zip, 0 = one per core
+    size_t extract_threads = 0;
+
+    // how long a cached release tag is trusted before revalidating it
+    std::chrono::seconds metadata_ttl{600};
+
+    // never touch the network for release metadata, use the cached tag
+    bool offline = false;
+
+    // skip entries whose file in the game directory already has the same
+    // size and CRC32
+    bool incremental = false;
+
+    // update an existing install by downloading only the zip entries that
+    // changed. entries are checked against their CRC32, the published
+    // SHA-256 only covers the whole archive
+    bool partial_update = false;
+
+    // concurrent targets in batch mode, 0 = one per core
+    size_t batch_jobs = 0;
+
+    // parallel byte ranges used when downloading the release zip to disk
+    size_t download_segments = 4;
+
+    // where release metadata and archives come from, without a trailing
+    // slash. pointing these at a local server lets the whole install run
+    // offline.
+    std::string api_base_url = "https://api.geode-sdk.org";
+    std::string release_base_url = "https://github.com/geode-sdk/geode/releases/download";
+
+    // GitHub REST API for the Geode repository, the release assets listed
+    // there carry the SHA-256 each download is checked against
+    std::string github_api_base_url = "https://api.github.com/repos/geode-sdk/geode";
+
+    // more servers with the same layout as api_base_url and release_base_url.
+    // API requests race all of them, downloads use the fastest and move on
+    // to the next one when it stalls.
+    std::vector<std::string> api_mirrors;
+    std::vector<std::string> release_mirrors;
+
+    // keep extracted releases in a content-addressed store and reflink (or
+    // copy) installs out of it instead of extracting every time
+    bool use_store = false;
+    // empty = <cache dir>/store
+    std::string store_dir;
+    // fall back to hardlinks where reflinks don't work. installs then share
+    // their files with the store, so one rewritten in place changes both
+    bool store_hardlinks = false;
+};
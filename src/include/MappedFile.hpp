@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace fs = std::filesystem;
+
+// read-only mmap of a whole file
+class MappedFile {
+public:
+    static std::optional<MappedFile> open(const fs::path& path);
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+
+private:
+    MappedFile(const char* data, size_t size) : data_(data), size_(size) {}
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
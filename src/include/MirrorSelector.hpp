@@ -0,0 +1,36 @@
+#pragma once
+
+#include "HttpClient.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+struct MirrorProbe {
+    std::string base_url;
+    // bytes per second over the probe, 0 when nothing arrived
+    double throughput = 0;
+    bool reachable = false;
+};
+
+// chooses between servers that host the same files. every base url is
+// tried at once, so a dead or slow mirror costs no more than the best one.
+class MirrorSelector {
+public:
+    explicit MirrorSelector(HttpClient& client);
+
+    // sends the request to every base url at once and returns the first
+    // response accepted, cancelling the rest. without an accepted one the
+    // last response is returned, and the last error thrown when every
+    // request failed
+    HttpResponse race(const std::vector<std::string>& base_urls, const std::string& path,
+                      const std::vector<std::string>& headers,
+                      const std::function<bool(const HttpResponse&)>& accept) const;
+
+    // downloads the start of base + path from every mirror at once and
+    // orders them by measured throughput, unreachable ones last. a single
+    // mirror is returned without probing it.
+    std::vector<MirrorProbe> rank(const std::vector<std::string>& base_urls, const std::string& path) const;
+
+private:
+    HttpClient& client_;
+};
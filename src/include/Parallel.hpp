@@ -0,0 +1,62 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 0 means one thread per core, never more threads than work items
+inline size_t resolve_thread_count(size_t requested, size_t work_items) {
+    size_t count = requested;
+    if (count == 0) {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    return std::max<size_t>(1, std::min(count, work_items));
+}
+
+// runs body(i) for every i in [0, count) on up to thread_count threads
+// (the calling thread included). indices are handed out in order, so
+// callers sort the most expensive work to the front. the first exception
+// stops the remaining work and is rethrown here.
+template <typename Body>
+void parallel_for(size_t count, size_t thread_count, Body&& body) {
+    std::atomic<size_t> next{0};
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        size_t index;
+        while ((index = next.fetch_add(1)) < count) {
+            try {
+                body(index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = count;
+            }
+        }
+    };
+
+    thread_count = resolve_thread_count(thread_count, count);
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; i++) {
+        threads.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct DiscoveryRoot {
+    fs::path path;
+    // "Wine", "Lutris", "Bottles" or "Heroic"
+    std::string launcher;
+};
+
+struct DiscoveredPrefix {
+    fs::path path;
+    std::string launcher;
+};
+
+struct DiscoveredInstall {
+    // the directory holding GeometryDash.exe
+    fs::path gd_path;
+    // the prefix the game sits inside of, Heroic and Lutris can keep games
+    // outside their prefix
+    std::optional<fs::path> prefix;
+    std::string launcher;
+};
+
+struct DiscoveryResult {
+    std::vector<DiscoveredPrefix> prefixes;
+    std::vector<DiscoveredInstall> installs;
+    // nanoseconds, of every directory the scan listed (and of missing
+    // roots). a new prefix or game adds an entry to one of them
+    std::map<fs::path, int64_t> mtimes;
+    bool from_cache = false;
+};
+
+// finds Wine prefixes and Geometry Dash installs outside of Steam. the roots
+// are walked breadth first, a whole level of directories at a time across
+// the threads, only a few levels deep and without following symlinks
+// (dosdevices and the profile folders link back into / and $HOME). a
+// directory with user.reg and drive_c is a prefix, a directory with
+// GeometryDash.exe is a game.
+class PrefixScanner {
+public:
+    // thread_count 0 = one per core, at least 8
+    PrefixScanner(std::vector<DiscoveryRoot> roots, fs::path cache_path, size_t thread_count = 0);
+
+    // ~/.wine, ~/.local/share/wineprefixes, Lutris' ~/Games, Bottles (native
+    // and Flatpak) and Heroic's ~/Games/Heroic
+    static std::vector<DiscoveryRoot> default_roots(const fs::path& home);
+
+    // the cached result as long as no listed directory changed and every
+    // cached game is still there, a fresh scan otherwise
+    DiscoveryResult discover(bool rescan = false) const;
+
+    DiscoveryResult scan() const;
+
+private:
+    std::optional<DiscoveryResult> load_cache() const;
+    bool save_cache(const DiscoveryResult& result) const;
+
+    std::vector<DiscoveryRoot> roots_;
+    fs::path cache_path_;
+    size_t thread_count_;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+
+// live byte and file counts of the install phases. nothing is reported
+// until a ProgressSession exists, until then a ProgressPhase costs one
+// relaxed atomic load and never allocates.
+bool progress_enabled();
+
+struct ProgressCounters;
+
+// one phase of an install, e.g. "download" or "extract". the counters are
+// atomics any thread may bump, the session samples them on its own thread.
+// name must be a string literal, it is stored by pointer.
+class ProgressPhase {
+public:
+    explicit ProgressPhase(const char* name, uint64_t total_bytes = 0, uint64_t total_items = 0);
+    ~ProgressPhase();
+
+    ProgressPhase(const ProgressPhase&) = delete;
+    ProgressPhase& operator=(const ProgressPhase&) = delete;
+
+    bool active() const { return counters_ != nullptr; }
+
+    void set_total(uint64_t bytes);
+    // for transfers that only learn the size once the response arrives,
+    // the first one wins
+    void set_total_if_unknown(uint64_t bytes);
+    void add_bytes(uint64_t bytes);
+    void add_items(uint64_t items = 1);
+    uint64_t get_bytes() const;
+
+private:
+    std::shared_ptr<ProgressCounters> counters_;
+};
+
+// enables progress reporting for its lifetime. a reporter thread samples
+// the running phases a few times a second and redraws a bar on stderr
+// (when it's a terminal) and/or writes one JSON object per line to
+// ndjson_fd: "start" and "end" events for every phase and rate limited
+// "progress" events with bytes, total, files, rate and ETA in between.
+class ProgressSession {
+public:
+    // ndjson_fd -1 = no event stream
+    ProgressSession(bool bar, int ndjson_fd);
+    ~ProgressSession();
+
+    ProgressSession(const ProgressSession&) = delete;
+    ProgressSession& operator=(const ProgressSession&) = delete;
+
+private:
+    void run();
+    void report(bool final);
+
+    bool bar_;
+    int ndjson_fd_;
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point last_ndjson_;
+    bool bar_drawn_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    bool stopping_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct CachedRelease {
+    // the API the tag came from, another one may serve other releases
+    std::string api_url;
+    std::string tag;
+    std::string etag;
+    std::string last_modified;
+    int64_t fetched_at = 0;
+};
+
+class ReleaseCache {
+public:
+    explicit ReleaseCache(fs::path file_path);
+
+    std::optional<CachedRelease> load() const;
+
+    // best effort, a read-only cache dir must not break installs
+    bool store(const CachedRelease& release) const;
+
+private:
+    fs::path file_path_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct StoreEntry {
+    // lowercase hex SHA-256, empty for directories
+    std::string digest;
+    uint64_t size = 0;
+    // relative to the install root, '/' separated
+    std::string path;
+};
+
+struct MaterializeStats {
+    size_t reflinked = 0;
+    size_t hardlinked = 0;
+    size_t copied = 0;
+    // already a hardlink to the right object
+    size_t unchanged = 0;
+    // the release's files relative to the destination
+    std::vector<std::string> files;
+};
+
+// extracted release files kept once per content under
+// <root>/objects/<2 hex>/<sha256>, plus one manifest per release tag
+// listing which object goes where. installs are materialized from it with
+// reflinks, falling back to hardlinks (when allowed) and then to
+// copy_file_range, so installing a release again never re-extracts it.
+class ReleaseStore {
+public:
+    // hardlinked installs share the inode with the store, a program that
+    // rewrites its own files in place would rewrite the object too
+    ReleaseStore(fs::path root, bool allow_hardlinks);
+
+    // the manifest is there and every object still has its recorded size
+    bool has_release(const std::string& tag) const;
+
+    // an empty directory to extract a release into before add_release()
+    fs::path create_staging_dir(const std::string& tag) const;
+
+    // hashes the extracted tree into objects, writes the manifest and
+    // removes the staging directory
+    void add_release(const std::string& tag, const fs::path& staging_dir, size_t thread_count) const;
+
+    MaterializeStats materialize(const std::string& tag, const fs::path& destination, size_t thread_count) const;
+
+private:
+    fs::path manifest_path(const std::string& tag) const;
+    fs::path object_path(const std::string& digest) const;
+
+    std::optional<std::vector<StoreEntry>> load_manifest(const std::string& tag) const;
+    void write_manifest(const std::string& tag, const std::vector<StoreEntry>& entries) const;
+
+    enum class Placement { Reflinked, Hardlinked, Copied, Unchanged };
+
+    Placement place_file(const fs::path& object, const fs::path& target) const;
+
+    fs::path root_;
+    bool allow_hardlinks_;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "HttpClient.hpp"
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct RemoteZipEntry {
+    std::string name;
+    uint32_t crc = 0;
+    uint64_t uncompressed_size = 0;
+    // the local header, data and data descriptor, up to where the next
+    // entry or the central directory starts
+    uint64_t offset = 0;
+    uint64_t span = 0;
+};
+
+// a zip on a server that honors byte ranges, read without downloading it:
+// the end of central directory record and the central directory first,
+// then only the entries asked for.
+class RemoteZip {
+public:
+    // fetches the central directory, throws when the server ignores ranges
+    RemoteZip(HttpClient& client, const std::string& url);
+
+    // in archive order
+    const std::vector<RemoteZipEntry>& get_entries() const { return entries_; }
+    uint64_t get_size() const { return size_; }
+    uint64_t get_fetched_bytes() const { return fetched_bytes_; }
+
+    // downloads the given entries and passes them to on_data in archive
+    // order, a run of local entries like the start of the zip itself.
+    // entries close together are fetched as one range, with the entries in
+    // between passed along too
+    void fetch_entries(const std::vector<const RemoteZipEntry*>& entries, const HttpDataCallback& on_data);
+
+private:
+    // inclusive, like the Range header. the body must be exactly that range
+    // of the same file the central directory came from
+    std::string fetch_range(uint64_t first, uint64_t last, ProgressPhase* progress = nullptr);
+
+    void parse_central_directory(const std::string& directory, uint64_t directory_offset, uint64_t entry_count);
+
+    HttpClient& client_;
+    std::string url_;
+    std::string etag_;
+    uint64_t size_ = 0;
+    std::atomic<uint64_t> fetched_bytes_{0};
+    std::vector<RemoteZipEntry> entries_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "HttpClient.hpp"
+#include "Progress.hpp"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// downloads a file as several byte ranges in parallel straight into a
+// preallocated output file. progress is kept in <output>.state, so an
+// interrupted download continues where it stopped on the next run.
+class SegmentedDownloader {
+public:
+    SegmentedDownloader(HttpClient& client, size_t segments);
+
+    // returns the SHA-256 of the downloaded file as hex, hashed on a separate
+    // thread while the download runs
+    std::string download(const std::string& url, const fs::path& output_path) const;
+
+    // the same file on several mirrors, best first. the first one is asked
+    // for the size, a range that fails on one continues on the next
+    std::string download(const std::vector<std::string>& urls, const fs::path& output_path) const;
+
+private:
+    struct Segment {
+        uint64_t start;
+        uint64_t end;
+        std::atomic<uint64_t> done{0};
+    };
+
+    struct DownloadState {
+        std::string url;
+        std::string etag;
+        uint64_t size = 0;
+        std::vector<std::unique_ptr<Segment>> segments;
+    };
+
+    std::string download_single(const std::vector<std::string>& urls, const fs::path& output_path) const;
+    void download_segment(const std::vector<std::string>& urls, int fd, Segment& segment,
+                          ProgressPhase& progress) const;
+
+    // bytes from the start of the file that are already on disk
+    static uint64_t contiguous_size(const std::vector<std::unique_ptr<Segment>>& segments);
+
+    // every segment's done, read once so it can be synced before it is saved
+    static std::vector<uint64_t> snapshot_done(const std::vector<std::unique_ptr<Segment>>& segments);
+
+    bool load_state(const fs::path& state_path, DownloadState& state) const;
+    // done holds snapshot_done() of state's segments
+    void save_state(const fs::path& state_path, const DownloadState& state, const std::vector<uint64_t>& done) const;
+
+    HttpClient& client_;
+    size_t segments_;
+};
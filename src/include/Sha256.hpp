@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// incremental SHA-256 (FIPS 180-4)
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, size_t size);
+
+    // finishes the hash, the object must not be updated afterwards
+    std::array<uint8_t, 32> digest();
+    std::string hex_digest();
+
+private:
+    void process_block(const uint8_t* block);
+
+    std::array<uint32_t, 8> state_;
+    std::array<uint8_t, 64> buffer_;
+    size_t buffer_size_ = 0;
+    uint64_t total_size_ = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Sha256.hpp"
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+// hashes a byte stream on its own thread. update() copies into a
+// single-producer/single-consumer ring of buffers and only blocks when the
+// hasher is a whole ring behind, so the producer never waits on SHA-256.
+class Sha256Pipeline {
+public:
+    Sha256Pipeline();
+    ~Sha256Pipeline();
+
+    Sha256Pipeline(const Sha256Pipeline&) = delete;
+    Sha256Pipeline& operator=(const Sha256Pipeline&) = delete;
+
+    // must always be called from the same thread
+    void update(const char* data, size_t size);
+
+    // flushes the ring, waits for the hasher and returns the hex digest
+    std::string finish();
+
+private:
+    static constexpr size_t kSlotCount = 16;
+    static constexpr size_t kSlotSize = 256 * 1024;
+    // set in head_ once the producer is done
+    static constexpr uint64_t kClosed = uint64_t(1) << 63;
+
+    struct Slot {
+        std::vector<char> data;
+        size_t size = 0;
+    };
+
+    void publish();
+    void close(bool flush);
+    void run();
+
+    std::array<Slot, kSlotCount> slots_;
+    // slots handed to the hasher, and slots it has finished with. both only
+    // ever grow, the slot index is the count modulo kSlotCount
+    std::atomic<uint64_t> head_{0};
+    std::atomic<uint64_t> tail_{0};
+
+    Sha256 sha_;
+    std::string digest_;
+    std::thread thread_;
+};
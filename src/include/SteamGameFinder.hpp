@@ -1,8 +1,10 @@
 #pragma once
 
+#include "SteamLibraryIndex.hpp"
 #include <filesystem>
+#include <memory>
+#include <mutex>
 #include <vector>
-#include <unordered_map>
 #include <optional>
 #include <string>
 
@@ -25,17 +27,21 @@ public:
                                                const std::optional<fs::path>& library_path = std::nullopt) const;
     GameInfo get_game_info(const std::string& app_id) const;
     
+    // resolves many app ids with one directory listing per library, an
+    // empty list means every installed app. results keep the requested order.
+    std::vector<GameInfo> get_games_info(const std::vector<std::string>& app_ids = {}) const;
+    
     const std::optional<fs::path>& get_steam_root() const { return steam_root_; }
     const std::vector<fs::path>& get_library_folders() const { return library_folders_; }
 
 private:
     std::optional<fs::path> find_steam_root() const;
+    std::vector<fs::path> load_library_folders() const;
     std::vector<fs::path> initialize_library_folders() const;
-    std::unordered_map<std::string, std::string> parse_vdf_file(const fs::path& file_path) const;
-    void parse_vdf_recursive(const std::string& content, size_t& pos, 
-                             std::unordered_map<std::string, std::string>& result, 
-                             const std::string& prefix = "") const;
     
     std::optional<fs::path> steam_root_;
     std::vector<fs::path> library_folders_;
+    
+    mutable std::mutex index_mutex_;
+    std::unique_ptr<SteamLibraryIndex> index_;
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct IndexedApp {
+    fs::path library_path;
+    std::string installdir;
+    int64_t manifest_mtime = 0;
+    std::optional<fs::path> proton_prefix;
+};
+
+// on-disk memo of Steam discovery. the library list is tied to the mtime
+// of libraryfolders.vdf and every app to the mtime of its appmanifest, so
+// a stale entry is detected with a single stat.
+class SteamLibraryIndex {
+public:
+    explicit SteamLibraryIndex(fs::path file_path);
+
+    void load();
+    bool save();
+
+    std::optional<std::vector<fs::path>> get_libraries(const fs::path& steam_root, int64_t libraryfolders_mtime) const;
+    void set_libraries(const fs::path& steam_root, int64_t libraryfolders_mtime, const std::vector<fs::path>& libraries);
+
+    std::optional<IndexedApp> get_app(const std::string& app_id) const;
+    void set_app(const std::string& app_id, const IndexedApp& app);
+
+    // nanoseconds of the file's mtime, 0 when it doesn't exist
+    static int64_t get_mtime(const fs::path& path);
+
+private:
+    fs::path file_path_;
+    bool dirty_ = false;
+
+    fs::path steam_root_;
+    int64_t libraryfolders_mtime_ = 0;
+    std::vector<fs::path> libraries_;
+    std::map<std::string, IndexedApp> apps_;
+};
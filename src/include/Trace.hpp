@@ -0,0 +1,61 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// spans are only recorded once tracing is enabled. until then a TraceSpan
+// costs one relaxed atomic load and never allocates.
+void enable_tracing();
+bool tracing_enabled();
+
+// writes every span recorded so far in Chrome trace event format
+// (chrome://tracing, Perfetto)
+void write_trace(const fs::path& path);
+
+struct TraceArg {
+    const char* key;
+    std::string text;
+    double number = 0;
+    bool is_text = false;
+};
+
+// times the enclosing scope. name and category must be string literals,
+// they are stored by pointer.
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category);
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    bool active() const { return active_; }
+
+    void set_arg(const char* key, double value);
+    void set_arg(const char* key, std::string value);
+
+private:
+    bool active_;
+    const char* name_;
+    const char* category_;
+    int64_t start_us_ = 0;
+    std::vector<TraceArg> args_;
+};
+
+// enables tracing for its lifetime and writes the trace file when it goes
+// out of scope, so every exit path of main produces one
+class TraceSession {
+public:
+    explicit TraceSession(fs::path path);
+    ~TraceSession();
+
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+
+private:
+    fs::path path_;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Valve KeyValues (.vdf / .acf) tree. keys and values are views into the
+// mapped file and nodes live in one flat array, linked by index.
+class VdfDocument {
+public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    struct Node {
+        std::string_view key;
+        // raw, still escaped. empty for blocks
+        std::string_view value;
+        uint32_t first_child = kNone;
+        uint32_t next_sibling = kNone;
+        bool is_block = false;
+    };
+
+    // nullopt when the file can't be read. with stop_after set, parsing
+    // ends as soon as every listed dotted path (e.g. "AppState.installdir")
+    // has been seen, the rest of the file is never tokenized.
+    static std::optional<VdfDocument> load(const fs::path& path,
+                                           const std::vector<std::string_view>& stop_after = {});
+
+    // content must outlive the document
+    static VdfDocument parse(std::string_view content, const std::vector<std::string_view>& stop_after = {});
+
+    // dotted path lookup, keys compare case-insensitively like Steam does
+    const Node* find_node(std::string_view path, const Node* from = nullptr) const;
+    std::optional<std::string_view> find(std::string_view path, const Node* from = nullptr) const;
+
+    const Node* first_child(const Node& node) const;
+    const Node* next_sibling(const Node& node) const;
+
+    size_t node_count() const { return nodes_.size() - 1; }
+
+    static std::string unescape(std::string_view value);
+
+private:
+    VdfDocument() = default;
+
+    void parse_content(std::string_view content, const std::vector<std::string_view>& stop_after);
+
+    std::optional<MappedFile> file_;
+    // nodes_[0] is an unnamed root holding the top level keys
+    std::vector<Node> nodes_;
+};
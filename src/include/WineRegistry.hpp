@@ -0,0 +1,37 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct RegistryEdit {
+    enum class Action { Set, SetIfMissing, Remove };
+
+    // key path as written between the brackets in the .reg file,
+    // e.g. Software\\Wine\\DllOverrides
+    std::string section;
+    std::string name;
+    // string data, written as "name"="value"
+    std::string value;
+    Action action = Action::Set;
+};
+
+// edits a Wine registry file (user.reg, system.reg) in one pass over an
+// mmap of it. the result replaces the file through a temp file and rename,
+// so readers and a crash only ever see the old or the new file.
+class WineRegistry {
+public:
+    explicit WineRegistry(fs::path reg_file_path);
+
+    void apply(const std::vector<RegistryEdit>& edits) const;
+
+    // the data of a named value as written in the file, without the quotes
+    // for strings. nullopt when the file, the section or the value is missing
+    std::optional<std::string> get_value(const std::string& section, const std::string& name) const;
+
+private:
+    fs::path reg_file_path_;
+};
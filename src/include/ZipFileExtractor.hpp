@@ -0,0 +1,64 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+struct ZipFileEntry {
+    std::string name;
+    uint16_t method = 0;
+    uint32_t crc = 0;
+    uint64_t compressed_size = 0;
+    uint64_t uncompressed_size = 0;
+    // start of the entry's data, past its local header
+    uint64_t data_offset = 0;
+};
+
+// extracts a zip on disk without libzip. the central directory is read from
+// a mapping of the archive, every deflated entry is inflated in one call into
+// a buffer of its final size (by libdeflate when built with it, zlib
+// otherwise), and stored entries are copied out of the archive by the kernel.
+class ZipFileExtractor {
+public:
+    // throws on an invalid archive, and on entries that are encrypted or use
+    // anything but store and deflate, which are left to libzip
+    explicit ZipFileExtractor(const fs::path& zip_path);
+    ~ZipFileExtractor();
+
+    ZipFileExtractor(const ZipFileExtractor&) = delete;
+    ZipFileExtractor& operator=(const ZipFileExtractor&) = delete;
+
+    // leave files that already match the entry's size and CRC untouched
+    void set_skip_unchanged(bool skip_unchanged) { skip_unchanged_ = skip_unchanged; }
+
+    // thread_count 0 = one per core
+    void extract(const fs::path& destination, size_t thread_count);
+
+    // files only, in archive order
+    const std::vector<ZipFileEntry>& get_entries() const { return entries_; }
+    uint64_t get_uncompressed_size() const { return uncompressed_size_; }
+    size_t get_extracted_count() const { return entries_.size() - skipped_count_; }
+    size_t get_skipped_count() const { return skipped_count_; }
+
+    // "libdeflate" or "zlib"
+    static const char* inflate_backend();
+
+private:
+    void parse_central_directory(uint64_t directory_offset, uint64_t directory_size, uint64_t entry_count);
+
+    fs::path zip_path_;
+    std::optional<MappedFile> mapping_;
+    int fd_ = -1;
+
+    std::vector<ZipFileEntry> entries_;
+    std::vector<std::string> directories_;
+    uint64_t uncompressed_size_ = 0;
+
+    bool skip_unchanged_ = false;
+    size_t skipped_count_ = 0;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// record signatures and fixed sizes of the zip format, and little endian
+// readers for its fields. callers check the bounds before reading
+
+inline constexpr uint32_t kLocalHeaderSignature = 0x04034b50;
+inline constexpr uint32_t kCentralHeaderSignature = 0x02014b50;
+inline constexpr uint32_t kEndOfCentralDirSignature = 0x06054b50;
+inline constexpr uint32_t kZip64EndOfCentralDirSignature = 0x06064b50;
+inline constexpr uint32_t kZip64LocatorSignature = 0x07064b50;
+inline constexpr uint32_t kDataDescriptorSignature = 0x08074b50;
+
+inline constexpr size_t kLocalHeaderSize = 30;
+inline constexpr size_t kCentralHeaderSize = 46;
+inline constexpr size_t kEndOfCentralDirSize = 22;
+inline constexpr size_t kZip64LocatorSize = 20;
+inline constexpr size_t kZip64EndOfCentralDirSize = 56;
+
+// entry names are written below the destination as they are, so one that
+// is absolute or climbs out with ".." must never reach the writer
+inline bool is_contained_entry_name(const std::string& name) {
+    if (name.empty() || name.front() == '/') {
+        return false;
+    }
+
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t end = name.find('/', start);
+        if (end == std::string::npos) {
+            end = name.size();
+        }
+        if (name.compare(start, end - start, "..") == 0) {
+            return false;
+        }
+        start = end + 1;
+    }
+    return true;
+}
+
+inline uint16_t read_u16(const char* data) {
+    return static_cast<uint16_t>(static_cast<unsigned char>(data[0]) | static_cast<unsigned char>(data[1]) << 8);
+}
+
+inline uint32_t read_u32(const char* data) {
+    return static_cast<uint32_t>(read_u16(data)) | static_cast<uint32_t>(read_u16(data + 2)) << 16;
+}
+
+inline uint64_t read_u64(const char* data) {
+    return static_cast<uint64_t>(read_u32(data)) | static_cast<uint64_t>(read_u32(data + 4)) << 32;
+}
+
+inline uint16_t read_u16(const std::string& buffer, size_t offset) {
+    return read_u16(buffer.data() + offset);
+}
+
+inline uint32_t read_u32(const std::string& buffer, size_t offset) {
+    return read_u32(buffer.data() + offset);
+}
+
+inline uint64_t read_u64(const std::string& buffer, size_t offset) {
+    return read_u64(buffer.data() + offset);
+}
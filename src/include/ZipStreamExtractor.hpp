@@ -0,0 +1,82 @@
+#pragma once
+
+#include "BatchedFileWriter.hpp"
+#include "Progress.hpp"
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <zlib.h>
+
+namespace fs = std::filesystem;
+
+class ZipStreamExtractor {
+public:
+    // with a staging_dir, entries are written there and only moved into
+    // destination by commit(). unchanged files are still compared against
+    // destination. staging_dir has to be on destination's filesystem
+    explicit ZipStreamExtractor(const fs::path& destination, const fs::path& staging_dir = {});
+    ~ZipStreamExtractor();
+
+    ZipStreamExtractor(const ZipStreamExtractor&) = delete;
+    ZipStreamExtractor& operator=(const ZipStreamExtractor&) = delete;
+
+    // leave files that already match the entry's size and CRC untouched
+    void set_skip_unchanged(bool skip_unchanged) { skip_unchanged_ = skip_unchanged; }
+
+    void feed(const char* data, size_t size);
+
+    void finish();
+
+    // renames the staged entries into destination and removes staging_dir
+    void commit();
+
+    size_t get_extracted_count() const { return extracted_count_; }
+    size_t get_skipped_count() const { return skipped_count_; }
+    // every file entry seen so far, written or skipped
+    const std::vector<std::string>& get_file_names() const { return file_names_; }
+
+private:
+    enum class State { Header, Data, Descriptor, Done };
+
+    size_t consume_header(const char* data, size_t size);
+    size_t consume_data(const char* data, size_t size);
+    size_t consume_descriptor(const char* data, size_t size);
+
+    void begin_entry();
+    void end_entry_data();
+    void finish_entry(uint32_t expected_crc);
+
+    fs::path destination_;
+    fs::path staging_dir_;
+    State state_ = State::Header;
+    std::string buffer_;
+
+    std::string entry_name_;
+    // the inflated entry, handed to the writer once its CRC checks out
+    std::vector<char> entry_data_;
+    bool writing_ = false;
+    uint16_t method_ = 0;
+    bool has_descriptor_ = false;
+    bool zip64_ = false;
+    uint32_t expected_crc_ = 0;
+    uint32_t crc_ = 0;
+    uint64_t remaining_ = 0;
+    // uncompressed size of a skipped entry, which is never inflated
+    uint64_t entry_size_ = 0;
+
+    z_stream inflate_stream_{};
+    bool inflate_ready_ = false;
+    bool skip_unchanged_ = false;
+    bool skip_data_ = false;
+    size_t extracted_count_ = 0;
+    size_t skipped_count_ = 0;
+    std::vector<std::string> file_names_;
+    // what commit() moves, skipped files stay where they are
+    std::vector<std::string> written_names_;
+    std::vector<std::string> directory_names_;
+    // the total isn't known until the central directory, which is never read
+    ProgressPhase progress_{"extract"};
+
+    BatchedFileWriter writer_;
+};
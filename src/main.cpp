@@ -1,6 +1,18 @@
 #include "GeodeInstaller.hpp"
+#include "InstallWatcher.hpp"
+#include "PrefixScanner.hpp"
+#include "CacheDir.hpp"
+#include "Trace.hpp"
+#include "Progress.hpp"
+#include <cstdlib>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <csignal>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 #define RESET   "\033[0m"
 #define BOLD    "\033[1m"
@@ -12,10 +24,457 @@
 #define CYAN    "\033[36m"
 #define WHITE   "\033[37m"
 
-int main() {
+// one target per line: <wine prefix><TAB><geometry dash path>, # starts a comment
+static std::vector<InstallTarget> load_job_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open job file: " + path);
+    }
+
+    std::vector<InstallTarget> targets;
+    std::string line;
+    int line_number = 0;
+
+    while (std::getline(file, line)) {
+        line_number++;
+
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": expected <prefix><TAB><gd path>");
+        }
+
+        targets.push_back({line.substr(0, tab), line.substr(tab + 1)});
+    }
+
+    return targets;
+}
+
+static int run_batch(const GeodeInstaller& installer, const std::vector<InstallTarget>& targets) {
+    std::vector<InstallResult> results;
+
+    try {
+        results = installer.install_geode_batch(targets);
+    } catch (const std::exception& e) {
+        std::cout << BOLD << RED << "❌ An error occurred: " << RESET << RED << e.what() << RESET << std::endl;
+        return 1;
+    }
+
+    size_t failed = 0;
+    std::cout << std::endl << BOLD << WHITE << "Summary:" << RESET << std::endl;
+
+    for (const auto& result : results) {
+        double seconds = result.duration.count() / 1000.0;
+
+        if (result.success) {
+            std::cout << GREEN << "✅ " << RESET << result.target.gd_path.string()
+                      << " (" << seconds << "s)" << std::endl;
+        } else {
+            failed++;
+            std::cout << RED << "❌ " << RESET << result.target.gd_path.string()
+                      << " (" << seconds << "s): " << RED << result.error << RESET << std::endl;
+        }
+    }
+
+    std::cout << std::endl << BOLD << (failed ? RED : GREEN) << results.size() - failed << "/"
+              << results.size() << " targets installed" << RESET << std::endl;
+
+    return failed ? 1 : 0;
+}
+
+static int run_verify(const GeodeInstaller& installer, const std::vector<fs::path>& gd_paths) {
+    size_t failed = 0;
+
+    for (const auto& path : gd_paths) {
+        auto start = std::chrono::steady_clock::now();
+        std::string gd_path = path.string();
+
+        try {
+            VerifyResult result = installer.verify_install(path);
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            if (result.intact()) {
+                std::cout << GREEN << "✅ " << RESET << gd_path << ": " << result.checked << " files intact ("
+                          << ms << "ms)" << std::endl;
+                continue;
+            }
+
+            failed++;
+            std::cout << RED << "❌ " << RESET << gd_path << ": " << RED << result.missing.size() << " missing, "
+                      << result.modified.size() << " modified" << RESET << " (" << ms << "ms)" << std::endl;
+            for (const auto& path : result.missing) {
+                std::cout << "   missing: " << path << std::endl;
+            }
+            for (const auto& path : result.modified) {
+                std::cout << "   modified: " << path << std::endl;
+            }
+            for (const auto& name : result.missing_registry) {
+                std::cout << "   registry override missing: " << name << std::endl;
+            }
+        } catch (const std::exception& e) {
+            failed++;
+            std::cout << RED << "❌ " << RESET << gd_path << ": " << RED << e.what() << RESET << std::endl;
+        }
+    }
+
+    std::cout << std::endl << BOLD << (failed ? RED : GREEN) << gd_paths.size() - failed << "/" << gd_paths.size()
+              << " installs intact" << RESET << std::endl;
+
+    return failed ? 1 : 0;
+}
+
+// the prefix whose override gets reverted comes from the manifest
+static int run_uninstall(const GeodeInstaller& installer, const std::vector<fs::path>& gd_paths) {
+    size_t failed = 0;
+
+    for (const auto& path : gd_paths) {
+        try {
+            UninstallResult result = installer.uninstall(path);
+            std::cout << GREEN << "✅ " << RESET << path.string() << ": removed " << result.removed << " files";
+            if (result.missing > 0) {
+                std::cout << " (" << result.missing << " already gone)";
+            }
+            if (result.reverted_registry > 0) {
+                std::cout << ", reverted the xinput1_4 override in " << result.registry_file.parent_path().string();
+            }
+            std::cout << std::endl;
+        } catch (const std::exception& e) {
+            failed++;
+            std::cout << RED << "❌ " << RESET << path.string() << ": " << RED << e.what() << RESET << std::endl;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
+
+static InstallWatcher* g_watcher = nullptr;
+
+static void stop_watching(int) {
+    if (g_watcher) {
+        g_watcher->stop();
+    }
+}
+
+static int run_watch(InstallerOptions options) {
+    // a reinstall only rewrites the files that changed
+    options.incremental = true;
+    GeodeInstaller installer(options);
+    SteamGameFinder finder;
+
+    if (!finder.get_steam_root()) {
+        std::cout << BOLD << RED << "❌ Can't find Steam Root" << RESET << std::endl;
+        return 1;
+    }
+
+    try {
+        InstallWatcher watcher(installer, finder);
+        g_watcher = &watcher;
+        std::signal(SIGINT, stop_watching);
+        std::signal(SIGTERM, stop_watching);
+
+        std::cout << BOLD << CYAN << "👀 Watching the Steam install of Geometry Dash, Ctrl+C to stop" << RESET << std::endl;
+        watcher.run();
+
+        std::signal(SIGINT, SIG_DFL);
+        std::signal(SIGTERM, SIG_DFL);
+        g_watcher = nullptr;
+    } catch (const std::exception& e) {
+        g_watcher = nullptr;
+        std::cout << BOLD << RED << "❌ An error occurred: " << RESET << RED << e.what() << RESET << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static PrefixScanner make_prefix_scanner() {
+    const char* home = getenv("HOME");
+    if (!home || !*home) {
+        throw std::runtime_error("HOME is not set");
+    }
+    return PrefixScanner(PrefixScanner::default_roots(home), get_cache_dir() / "wine-targets.json");
+}
+
+// prints every game found inside a prefix as a --batch job file
+static int run_discover(bool rescan) {
+    DiscoveryResult result;
+    try {
+        result = make_prefix_scanner().discover(rescan);
+    } catch (const std::exception& e) {
+        std::cerr << BOLD << RED << "❌ An error occurred: " << RESET << RED << e.what() << RESET << std::endl;
+        return 1;
+    }
+
+    for (const auto& install : result.installs) {
+        if (install.prefix) {
+            std::cout << install.prefix->string() << "\t" << install.gd_path.string() << std::endl;
+        } else {
+            std::cout << "# no prefix (" << install.launcher << "): " << install.gd_path.string() << std::endl;
+        }
+    }
+
+    return 0;
+}
+
+// a prefix from the discovered ones by number, or any path typed in
+static fs::path choose_wine_prefix(const DiscoveryResult& result) {
+    for (size_t i = 0; i < result.prefixes.size(); i++) {
+        std::cout << BOLD << MAGENTA << i + 1 << "." << RESET << " " << result.prefixes[i].path.string()
+                  << " (" << result.prefixes[i].launcher << ")" << std::endl;
+    }
+
+    std::cout << YELLOW << "Enter your " << MAGENTA << "Wine" << RESET << YELLOW << " prefix path"
+              << (result.prefixes.empty() ? "" : " or its number") << ": " << RESET;
+    std::string input;
+    std::getline(std::cin, input);
+
+    if (!input.empty() && input.find_first_not_of("0123456789") == std::string::npos) {
+        size_t index = std::stoul(input);
+        if (index >= 1 && index <= result.prefixes.size()) {
+            return result.prefixes[index - 1].path;
+        }
+    }
+
+    return input;
+}
+
+// lists the games found under the usual Wine, Lutris, Bottles and Heroic
+// directories, typing the paths is the fallback
+static InstallTarget choose_wine_target(bool rescan) {
+    std::optional<PrefixScanner> scanner;
+    DiscoveryResult result;
+
+    try {
+        scanner.emplace(make_prefix_scanner());
+        result = scanner->discover(rescan);
+    } catch (const std::exception& e) {
+        std::cout << YELLOW << "Couldn't search for Wine prefixes: " << e.what() << RESET << std::endl;
+    }
+
+    while (!result.installs.empty()) {
+        std::cout << BOLD << WHITE << "Geometry Dash installs found:" << RESET << std::endl;
+        for (size_t i = 0; i < result.installs.size(); i++) {
+            const auto& install = result.installs[i];
+            std::cout << BOLD << MAGENTA << i + 1 << "." << RESET << " " << install.gd_path.string()
+                      << " (" << install.launcher;
+            if (install.prefix) {
+                std::cout << ", prefix " << install.prefix->string();
+            }
+            std::cout << ")" << std::endl;
+        }
+        std::cout << BOLD << MAGENTA << "r." << RESET << " Search again" << std::endl;
+        std::cout << BOLD << MAGENTA << "m." << RESET << " Enter the paths by hand" << std::endl;
+        std::cout << YELLOW << "Which one: " << RESET;
+
+        std::string input;
+        std::getline(std::cin, input);
+
+        if (input == "m") {
+            break;
+        }
+
+        if (input == "r") {
+            result = scanner->discover(true);
+            continue;
+        }
+
+        size_t index = 0;
+        if (!input.empty() && input.find_first_not_of("0123456789") == std::string::npos) {
+            index = std::stoul(input);
+        }
+        if (index == 0 || index > result.installs.size()) {
+            std::cout << BOLD << RED << "❌ Invalid choice. Please try again." << RESET << std::endl;
+            continue;
+        }
+
+        const auto& install = result.installs[index - 1];
+        if (install.prefix) {
+            return {*install.prefix, install.gd_path};
+        }
+        return {choose_wine_prefix(result), install.gd_path};
+    }
+
+    std::cout << YELLOW << "Enter your Geometry Dash path: " << RESET;
+    std::string gd_path;
+    std::getline(std::cin, gd_path);
+
+    return {choose_wine_prefix(result), gd_path};
+}
+
+int main(int argc, char* argv[]) {
+    InstallerOptions options;
+    std::vector<InstallTarget> batch_targets;
+    std::string trace_path;
+    bool progress_bar = false;
+    int progress_fd = -1;
+    bool watch = false;
+    std::vector<fs::path> verify_paths;
+    std::vector<fs::path> uninstall_paths;
+    bool discover = false;
+    bool rescan = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--no-stream") {
+            options.stream_extract = false;
+        } else if (arg == "--extract-threads" && i + 1 < argc) {
+            try {
+                options.extract_threads = std::stoul(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cout << BOLD << RED << "❌ Invalid thread count: " << argv[i] << RESET << std::endl;
+                return 1;
+            }
+        } else if (arg == "--batch" && i + 1 < argc) {
+            try {
+                auto targets = load_job_file(argv[++i]);
+                batch_targets.insert(batch_targets.end(), targets.begin(), targets.end());
+            } catch (const std::exception& e) {
+                std::cout << BOLD << RED << "❌ " << e.what() << RESET << std::endl;
+                return 1;
+            }
+        } else if (arg == "--target" && i + 2 < argc) {
+            batch_targets.push_back({argv[i + 1], argv[i + 2]});
+            i += 2;
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            try {
+                options.batch_jobs = std::stoul(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cout << BOLD << RED << "❌ Invalid job count: " << argv[i] << RESET << std::endl;
+                return 1;
+            }
+        } else if (arg == "--segments" && i + 1 < argc) {
+            try {
+                options.download_segments = std::stoul(argv[++i]);
+            } catch (const std::exception& e) {
+                std::cout << BOLD << RED << "❌ Invalid segment count: " << argv[i] << RESET << std::endl;
+                return 1;
+            }
+        } else if (arg == "--incremental") {
+            options.incremental = true;
+        } else if (arg == "--partial-update") {
+            options.partial_update = true;
+        } else if (arg == "--offline") {
+            options.offline = true;
+        } else if (arg == "--metadata-ttl" && i + 1 < argc) {
+            try {
+                options.metadata_ttl = std::chrono::seconds(std::stol(argv[++i]));
+            } catch (const std::exception& e) {
+                std::cout << BOLD << RED << "❌ Invalid TTL: " << argv[i] << RESET << std::endl;
+                return 1;
+            }
+        } else if (arg == "--api-url" && i + 1 < argc) {
+            options.api_base_url = argv[++i];
+        } else if (arg == "--release-url" && i + 1 < argc) {
+            options.release_base_url = argv[++i];
+        } else if (arg == "--api-mirror" && i + 1 < argc) {
+            options.api_mirrors.push_back(argv[++i]);
+        } else if (arg == "--mirror" && i + 1 < argc) {
+            options.release_mirrors.push_back(argv[++i]);
+        } else if (arg == "--github-api-url" && i + 1 < argc) {
+            options.github_api_base_url = argv[++i];
+        } else if (arg == "--watch") {
+            watch = true;
+        } else if (arg == "--verify" && i + 1 < argc) {
+            verify_paths.push_back(argv[++i]);
+        } else if (arg == "--verify-batch" && i + 1 < argc) {
+            // the prefixes in a job file play no part in checking an install
+            try {
+                for (const auto& target : load_job_file(argv[++i])) {
+                    verify_paths.push_back(target.gd_path);
+                }
+            } catch (const std::exception& e) {
+                std::cout << BOLD << RED << "❌ " << e.what() << RESET << std::endl;
+                return 1;
+            }
+        } else if (arg == "--uninstall" && i + 1 < argc) {
+            uninstall_paths.push_back(argv[++i]);
+        } else if (arg == "--discover") {
+            discover = true;
+        } else if (arg == "--rescan") {
+            rescan = true;
+        } else if (arg == "--store") {
+            options.use_store = true;
+        } else if (arg == "--store-dir" && i + 1 < argc) {
+            options.use_store = true;
+            options.store_dir = argv[++i];
+        } else if (arg == "--store-hardlinks") {
+            options.use_store = true;
+            options.store_hardlinks = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--progress") {
+            progress_bar = true;
+        } else if (arg == "--progress-fd" && i + 1 < argc) {
+            try {
+                progress_fd = std::stoi(argv[++i]);
+            } catch (const std::exception& e) {
+                progress_fd = -1;
+            }
+            if (progress_fd < 0) {
+                std::cout << BOLD << RED << "❌ Invalid file descriptor: " << argv[i] << RESET << std::endl;
+                return 1;
+            }
+        } else {
+            std::cout << BOLD << RED << "❌ Unknown argument: " << arg << RESET << std::endl;
+            return 1;
+        }
+    }
+
+    // declared before the installer so Steam discovery is traced too, and
+    // destroyed after it so the file is written on every return below
+    std::optional<TraceSession> trace_session;
+    if (!trace_path.empty()) {
+        trace_session.emplace(trace_path);
+    }
+
+    std::optional<ProgressSession> progress_session;
+    if (progress_bar || progress_fd >= 0) {
+        // a reader that closes its end of a pipe must not kill the install
+        if (progress_fd >= 0) {
+            std::signal(SIGPIPE, SIG_IGN);
+        }
+        progress_session.emplace(progress_bar, progress_fd);
+    }
+
+    if (watch) {
+        return run_watch(options);
+    }
+
+    if (discover) {
+        return run_discover(rescan);
+    }
+
+    if (!verify_paths.empty() && !uninstall_paths.empty()) {
+        std::cout << BOLD << RED << "❌ --verify and --uninstall can't be combined" << RESET << std::endl;
+        return 1;
+    }
+
+    if (!verify_paths.empty()) {
+        GeodeInstaller installer(options);
+        return run_verify(installer, verify_paths);
+    }
+
+    if (!uninstall_paths.empty()) {
+        GeodeInstaller installer(options);
+        return run_uninstall(installer, uninstall_paths);
+    }
+
+    if (!batch_targets.empty()) {
+        GeodeInstaller installer(options);
+        return run_batch(installer, batch_targets);
+    }
+
     system("clear");
 
-    GeodeInstaller installer;
+    GeodeInstaller installer(options);
     std::string input;
     int choice;
 
@@ -51,15 +510,8 @@ int main() {
                 
                 case 2: {
                     std::cout << BOLD << MAGENTA << "🍷 Wine Installation" << RESET << std::endl;
-                    std::cout << YELLOW << "Enter your Geometry Dash path: " << RESET;
-                    std::string gd_path;
-                    std::getline(std::cin, gd_path);
-
-                    std::cout << YELLOW << "Enter your " << MAGENTA << "Wine" << RESET << YELLOW << " prefix path: " << RESET;
-                    std::string wine_prefix;
-                    std::getline(std::cin, wine_prefix);
-
-                    installer.install_geode_to_wine(wine_prefix, gd_path);
+                    InstallTarget target = choose_wine_target(rescan);
+                    installer.install_geode_to_wine(target.prefix, target.gd_path);
                     break;
                 }
                 